@@ -0,0 +1,219 @@
+/**
+ * File              : bench.c
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+/* parse every .doc file of corpus directory with each mode
+ * (doc_parse and other paths of library) and print 
+ * throughput and latency as JSON line for each mode:
+ *   doc_bench [-w warmup] [-r repetitions] [-m mode] dir 
+ * Each mode runs in its own process, so max_rss_kb is peak
+ * memory of the mode. Modes are in bench.h */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "bench.h"
+
+/* corpus files */
+struct corpus {
+	char **path;
+	long *size;
+	int n;
+};
+
+static int corpus_load(struct corpus *c, const char *dir)
+{
+	DIR *d = opendir(dir);
+	if (!d){
+		perror(dir);
+		return -1;
+	}
+	
+	memset(c, 0, sizeof(struct corpus));
+	int cap = 0;
+	struct dirent *e;
+	while ((e = readdir(d))) {
+		size_t len = strlen(e->d_name);
+		if (len < 4 || strcasecmp(e->d_name + len - 4, ".doc"))
+			continue;
+		
+		char path[BUFSIZ];
+		snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+		struct stat st;
+		if (stat(path, &st) || !S_ISREG(st.st_mode))
+			continue;
+
+		if (c->n == cap){
+			cap = cap ? cap * 2 : 64;
+			c->path = realloc(c->path, cap * sizeof(char *));
+			c->size = realloc(c->size, cap * sizeof(long));
+			if (!c->path || !c->size){
+				perror("realloc");
+				closedir(d);
+				return -1;
+			}
+		}
+		c->path[c->n] = strdup(path);
+		c->size[c->n] = st.st_size;
+		c->n++;
+	}
+	closedir(d);
+	return 0;
+}
+
+static int double_compare(const void *a, const void *b)
+{
+	double x = *(double *)a, y = *(double *)b;
+	return x < y ? -1 : x > y;
+}
+
+static double percentile(double *a, int n, double p)
+{
+	if (n == 0)
+		return 0;
+	int i = (int)(p * (n - 1) + 0.5);
+	return a[i];
+}
+
+static int run_mode(struct mode *m, struct corpus *c, 
+		int warmup, int reps)
+{
+	int i, r;
+	for (r = 0; r < warmup; ++r)
+		for (i = 0; i < c->n; ++i)
+			m->run(c->path[i]);
+
+	int n = c->n * reps;
+	double *lat = malloc((n ? n : 1) * sizeof(double));
+	if (!lat){
+		perror("malloc");
+		return -1;
+	}
+
+	unsigned long long bytes = 0, chars = 0;
+	int errors = 0, k = 0;
+	double total = 0;
+	for (r = 0; r < reps; ++r) {
+		for (i = 0; i < c->n; ++i) {
+			double t = now();
+			int ret = m->run(c->path[i]);
+			t = now() - t;
+			
+			// counters of document closed by run
+			lds_t s;
+			doc_get_stats(NULL, &s);
+			
+			if (ret && ret != DOC_CB_STOP)
+				errors++;
+			lat[k++] = t;
+			total += t;
+			bytes += c->size[i];
+			chars += s.chars;
+		}
+	}
+	qsort(lat, n, sizeof(double), double_compare);
+
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+
+	printf("{\"mode\":\"%s\",\"docs\":%d,\"reps\":%d,"
+			"\"errors\":%d,\"bytes\":%llu,\"chars\":%llu,"
+			"\"seconds\":%.6f,\"mb_per_s\":%.3f,"
+			"\"chars_per_s\":%.0f,\"docs_per_s\":%.3f,"
+			"\"p50_ms\":%.3f,\"p99_ms\":%.3f,"
+			"\"max_rss_kb\":%ld}\n",
+			m->name, c->n, reps, errors, bytes, chars, total,
+			total > 0 ? bytes / total / 1e6 : 0,
+			total > 0 ? chars / total : 0,
+			total > 0 ? n / total : 0,
+			percentile(lat, n, 0.50) * 1e3,
+			percentile(lat, n, 0.99) * 1e3,
+			ru.ru_maxrss);
+	fflush(stdout);
+
+	free(lat);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, 
+			"Usage: %s [-w warmup] [-r repetitions] [-m mode] dir\n"
+			"modes:", prog);
+	struct mode *m;
+	for (m = modes; m->name; ++m)
+		fprintf(stderr, " %s", m->name);
+	fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int warmup = 1, reps = 5, opt;
+	const char *mode = NULL;
+	while ((opt = getopt(argc, argv, "w:r:m:h")) != -1) {
+		switch (opt) {
+			case 'w': warmup = atoi(optarg); break;
+			case 'r': reps = atoi(optarg); break;
+			case 'm': mode = optarg; break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind != argc - 1 || reps < 1){
+		usage(argv[0]);
+		return 1;
+	}
+
+	// library messages of broken files are not timed
+	doc_set_log(DOC_LOG_NONE, NULL, NULL);
+
+	struct corpus c;
+	if (corpus_load(&c, argv[optind]))
+		return 1;
+	if (c.n == 0){
+		fprintf(stderr, "no .doc files in %s\n", argv[optind]);
+		return 1;
+	}
+
+	int found = 0;
+	struct mode *m;
+	for (m = modes; m->name; ++m) {
+		if (mode && strcmp(mode, m->name))
+			continue;
+		found = 1;
+		// peak RSS of process is the peak of mode only
+		pid_t pid = fork();
+		if (pid < 0){
+			perror("fork");
+			return 1;
+		}
+		if (pid == 0)
+			_exit(run_mode(m, &c, warmup, reps) ? 1 : 0);
+		
+		int status;
+		if (waitpid(pid, &status, 0) < 0 || 
+				!WIFEXITED(status) || WEXITSTATUS(status))
+		{
+			fprintf(stderr, "mode %s failed\n", m->name);
+			return 1;
+		}
+	}
+	if (!found){
+		usage(argv[0]);
+		return 1;
+	}
+
+	return 0;
+}
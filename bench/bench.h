@@ -0,0 +1,132 @@
+/**
+ * File              : bench.h
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+/* common parts of benchmarks: clock, instruction counter,
+ * empty callbacks and table of modes. New fast paths of
+ * library are added to table of modes - doc_bench and
+ * doc_perfcheck measure the same modes */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/libdoc.h"
+
+static inline double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* hardware counter (PERF_COUNT_HW_*) of this thread - 
+ * return -1 if there is no counter */
+static inline int counter_open(unsigned long long config)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* instructions of this thread - return -1 if there is no
+ * counter */
+static inline int insns_open()
+{
+	return counter_open(PERF_COUNT_HW_INSTRUCTIONS);
+}
+
+static inline void counter_start(int counter)
+{
+	ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+	ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+/* count since counter_start - 0 on error */
+static inline long long counter_stop(int counter)
+{
+	long long c = 0;
+	ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+	if (read(counter, &c, sizeof(c)) != sizeof(c))
+		c = 0;
+	return c;
+}
+
+static inline int styles_cb(void *d, STYLE *s){
+	return 0;
+}
+
+static inline int text_cb(void *d, DOC_PART part, ldp_t *p, int ch){
+	return 0;
+}
+
+static inline int picture_cb(void *d, ldb_t *blip){
+	return 0;
+}
+
+/* modes - return non-zero on error */
+static inline int mode_parse(const char *path)
+{
+	return doc_parse(path, NULL, styles_cb, text_cb);
+}
+
+static inline int mode_text(const char *path)
+{
+	int ret;
+	libdoc_t *doc = doc_open(path, &ret);
+	if (!doc)
+		return ret;
+	ret = doc_parse_text(doc, 0, (unsigned long)-1, NULL, text_cb);
+	doc_close(doc);
+	return ret;
+}
+
+static inline int mode_styles(const char *path)
+{
+	int ret;
+	libdoc_t *doc = doc_open(path, &ret);
+	if (!doc)
+		return ret;
+	ret = doc_parse_styles(doc, NULL, styles_cb);
+	doc_close(doc);
+	return ret;
+}
+
+static inline int mode_pictures(const char *path)
+{
+	int ret;
+	libdoc_t *doc = doc_open(path, &ret);
+	if (!doc)
+		return ret;
+	ret = doc_extract_pictures(doc, NULL, picture_cb);
+	doc_close(doc);
+	return ret;
+}
+
+static struct mode {
+	const char *name;
+	int (*run)(const char *path);
+} modes[] __attribute__((unused)) = {
+	{"parse",    mode_parse},
+	{"text",     mode_text},
+	{"styles",   mode_styles},
+	{"pictures", mode_pictures},
+	{NULL, NULL}
+};
+
+#endif /* BENCH_H */
@@ -0,0 +1,368 @@
+/**
+ * File              : difftest.c
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+/* differential test of fast paths: parse each document
+ * with doc_parse_text as usual, then again in reference
+ * mode (doc_set_reference) with one call for each CP, and
+ * compare CP to FC mapping of piece tables, text and
+ * properties passed to callback:
+ *   doc_difftest [-n max_cp] file.doc ...
+ * First divergence of file is printed with CP, piece and
+ * FKP context and property snapshot of run where it is
+ * found. Return 1 if any file diverges */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/libdoc/doc.h"
+
+/* character passed to text callback */
+struct event {
+	CP       cp;
+	int      ch;
+	int      part;
+	uint64_t hash;      // hash of properties
+};
+
+/* properties at run boundary - where hash changes */
+struct snapshot {
+	size_t event;       // index of first event of run
+	ldp_t  prop;
+};
+
+struct trace {
+	struct event *e;
+	size_t n, cap;
+	struct snapshot *s;
+	size_t ns, caps;
+	size_t k;           // compared event in reference pass
+	int diverged;
+	struct event ref;   // event of reference pass
+	ldp_t refProp;
+};
+
+/* FNV-1a of properties without data pointer and CP, so
+ * hash changes at run boundaries only */
+static uint64_t prop_hash(const ldp_t *p)
+{
+	ldp_t q = *p;
+	q.chp.cp = 0;
+	const BYTE *b = (const BYTE *)&q;
+	uint64_t h = 0xcbf29ce484222325ULL;
+	size_t i;
+	for (i = 0; i < offsetof(ldp_t, data); ++i) {
+		h ^= b[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static void *grow(void *p, size_t *cap, size_t size)
+{
+	*cap = *cap ? *cap * 2 : 1024;
+	p = realloc(p, *cap * size);
+	if (!p){
+		perror("realloc");
+		exit(ENOMEM);
+	}
+	return p;
+}
+
+static int fast_cb(void *d, DOC_PART part, ldp_t *p, int ch)
+{
+	struct trace *t = d;
+	if (t->n == t->cap)
+		t->e = grow(t->e, &t->cap, sizeof(struct event));
+	struct event *e = &t->e[t->n];
+	e->cp   = p->chp.cp;
+	e->ch   = ch;
+	e->part = part;
+	e->hash = prop_hash(p);
+
+	if (!t->ns || t->e[t->n - 1].hash != e->hash){
+		if (t->ns == t->caps)
+			t->s = grow(t->s, &t->caps, sizeof(struct snapshot));
+		t->s[t->ns].event = t->n;
+		t->s[t->ns].prop  = *p;
+		t->ns++;
+	}
+	t->n++;
+	return 0;
+}
+
+static int ref_cb(void *d, DOC_PART part, ldp_t *p, int ch)
+{
+	struct trace *t = d;
+	struct event e = {p->chp.cp, ch, part, prop_hash(p)};
+	if (t->k < t->n &&
+			t->e[t->k].cp   == e.cp &&
+			t->e[t->k].ch   == e.ch &&
+			t->e[t->k].part == e.part &&
+			t->e[t->k].hash == e.hash)
+	{
+		t->k++;
+		return 0;
+	}
+
+	// stop at first divergence
+	t->diverged = 1;
+	t->ref = e;
+	t->refProp = *p;
+	return 1;
+}
+
+/* CP to FC mapping of piece table - return piece index or
+ * -1 if CP is not in PlcPcd */
+static int cp_to_fc(cfb_doc_t *doc, CP cp, ULONG *fc,
+		int *compressed)
+{
+	struct PlcPcd *PlcPcd = doc_plcpcd(doc);
+	if (!PlcPcd)
+		return -1;
+	int i = plc_search(PlcPcd->aCp, PlcPcd->aCPl, cp);
+	if (i < 0 || i + 1 >= PlcPcd->aCPl)
+		return -1;
+	struct FcCompressed f = PlcPcd->aPcd[i].fc;
+	*compressed = FcCompressed(f);
+	if (*compressed)
+		*fc = FcValue(f) / 2 + (cp - PlcPcd->aCp[i]);
+	else
+		*fc = FcValue(f) + 2 * (cp - PlcPcd->aCp[i]);
+	return i;
+}
+
+static void print_piece(const char *name, cfb_doc_t *doc, CP cp)
+{
+	ULONG fc;
+	int compressed;
+	int i = cp_to_fc(doc, cp, &fc, &compressed);
+	if (i < 0){
+		printf("  %s piece: none\n", name);
+		return;
+	}
+	struct PlcPcd *PlcPcd = doc_plcpcd(doc);
+	printf("  %s piece: %d of %u, CP %u-%u, fc %u, %s, prm 0x%04x\n",
+			name, i, PlcPcd->aCPl - 1,
+			PlcPcd->aCp[i], PlcPcd->aCp[i + 1], fc,
+			compressed ? "compressed" : "unicode",
+			PlcPcd->aPcd[i].prm);
+}
+
+/* FKP pages and runs of character at cp */
+static void print_fkp(cfb_doc_t *doc, CP cp)
+{
+	ULONG fc;
+	int compressed;
+	if (cp_to_fc(doc, cp, &fc, &compressed) < 0)
+		return;
+
+	struct PlcBteChpx *chpx = doc_plcbteChpx(doc);
+	int i = chpx ?
+		plc_search(chpx->aFc, doc->plcbteChpxNaFc, fc) : -1;
+	if (i >= 0 && i + 1 < doc->plcbteChpxNaFc){
+		ULONG pn = pnFkpChpx_pn(chpx->aPnBteChpx[i]);
+		printf("  chpx: bte %d, fc %u-%u, page %u",
+				i, chpx->aFc[i], chpx->aFc[i + 1], pn);
+		BYTE *buf = doc_fkp_page(doc, &doc->chpxCache, pn * 512);
+		if (buf){
+			struct ChpxFkp fkp;
+			chpxFkp_set(&fkp, buf);
+			int j = plc_search(fkp.rgfc, fkp.crun + 1, fc);
+			if (j >= 0 && j < fkp.crun)
+				printf(", run %d of %d, fc %u-%u, chpx at %d",
+						j, fkp.crun, fkp.rgfc[j], fkp.rgfc[j + 1],
+						fkp.rgb[j] * 2);
+		}
+		printf("\n");
+	}
+
+	struct PlcBtePapx *papx = doc_plcbtePapx(doc);
+	i = papx ?
+		plc_search(papx->aFc, doc->plcbtePapxNaFc, fc) : -1;
+	if (i >= 0 && i + 1 < doc->plcbtePapxNaFc)
+		printf("  papx: bte %d, fc %u-%u, page %u\n",
+				i, papx->aFc[i], papx->aFc[i + 1],
+				pnFkpPapx_pn(papx->aPnBtePapx[i]));
+}
+
+/* members of properties that differ */
+static void print_prop_diff(const ldp_t *a, const ldp_t *b)
+{
+	static const struct {
+		const char *name;
+		size_t off, size;
+	} m[] = {
+		{"dop",     offsetof(ldp_t, dop),     sizeof(DOP)},
+		{"sep",     offsetof(ldp_t, sep),     sizeof(SEP)},
+		{"pap",     offsetof(ldp_t, pap),     sizeof(PAP)},
+		{"pap_chp", offsetof(ldp_t, pap_chp), sizeof(CHP)},
+		{"chp",     offsetof(ldp_t, chp),     sizeof(CHP)},
+		{"trp",     offsetof(ldp_t, trp),     sizeof(TRP)},
+		{"tcp",     offsetof(ldp_t, tcp),     sizeof(TCP)},
+	};
+	const BYTE *pa = (const BYTE *)a, *pb = (const BYTE *)b;
+	size_t i, j;
+	for (i = 0; i < sizeof(m)/sizeof(*m); ++i) {
+		for (j = 0; j < m[i].size; ++j) {
+			size_t o = m[i].off + j;
+			if (pa[o] != pb[o]){
+				printf("  props: %s differs at byte %zu: "
+						"fast 0x%02x, reference 0x%02x\n",
+						m[i].name, j, pa[o], pb[o]);
+				break;
+			}
+		}
+	}
+}
+
+static void print_event(const char *name, const struct event *e)
+{
+	printf("  %s: CP %u, part %d, ch 0x%04x\n",
+			name, e->cp, e->part, e->ch & 0xffff);
+}
+
+static int diff_mapping(const char *path,
+		cfb_doc_t *fast, cfb_doc_t *ref, CP last)
+{
+	CP cp;
+	for (cp = 0; cp < last; ++cp) {
+		ULONG ffc = 0, rfc = 0;
+		int fc = 0, rc = 0;
+		int fi = cp_to_fc(fast, cp, &ffc, &fc);
+		int ri = cp_to_fc(ref,  cp, &rfc, &rc);
+		if ((fi < 0) != (ri < 0) || ffc != rfc || fc != rc){
+			printf("%s: CP mapping diverges at CP %u\n", path, cp);
+			print_piece("fast", fast, cp);
+			print_piece("reference", ref, cp);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int diff_text(const char *path,
+		cfb_doc_t *fast, cfb_doc_t *ref, CP last)
+{
+	struct trace t;
+	memset(&t, 0, sizeof(t));
+	int ret = 1;
+
+	int fret = doc_parse_text(fast, 0, last, &t, fast_cb);
+	int rret = 0;
+	CP cp;
+	for (cp = 0; cp < last && !t.diverged && !rret; ++cp)
+		rret = doc_parse_text(ref, cp, cp + 1, &t, ref_cb);
+	if (t.diverged)
+		rret = 0;
+
+	if (!t.diverged && t.k < t.n){
+		// reference pass has less characters
+		t.diverged = 1;
+		t.ref.cp = t.e[t.k].cp;
+		t.ref.ch = -1;
+		t.refProp = ref->prop;
+	}
+
+	if (t.diverged){
+		CP at = t.k < t.n ? t.e[t.k].cp : t.ref.cp;
+		printf("%s: text diverges at CP %u (character %zu)\n",
+				path, at, t.k);
+		if (t.k < t.n)
+			print_event("fast", &t.e[t.k]);
+		else
+			printf("  fast: no more characters\n");
+		if (t.ref.ch == -1)
+			printf("  reference: no more characters\n");
+		else
+			print_event("reference", &t.ref);
+		print_piece("fast", fast, at);
+		print_fkp(ref, at);
+
+		// run of fast pass that contains character
+		if (t.ns && t.k < t.n){
+			size_t s = t.ns - 1;
+			while (s > 0 && t.s[s].event > t.k)
+				s--;
+			printf("  run: starts at CP %u\n", t.e[t.s[s].event].cp);
+			print_prop_diff(&t.s[s].prop, &t.refProp);
+		}
+	} else if (fret != rret){
+		printf("%s: fast pass returned %d, reference %d\n",
+				path, fret, rret);
+	} else {
+		printf("%s: ok, %u CP, %zu characters, %zu runs\n",
+				path, last, t.n, t.ns);
+		ret = 0;
+	}
+
+	free(t.e);
+	free(t.s);
+	return ret;
+}
+
+static int difftest(const char *path, unsigned long max_cp)
+{
+	int err;
+	cfb_doc_t *fast = doc_open(path, &err);
+	if (!fast){
+		printf("%s: can't open: %d\n", path, err);
+		return 1;
+	}
+	cfb_doc_t *ref = doc_open(path, &err);
+	if (!ref){
+		printf("%s: can't open: %d\n", path, err);
+		doc_close(fast);
+		return 1;
+	}
+	doc_set_reference(ref, 1);
+
+	CP last = fast->fib.rgLw97->ccpText;
+	if (max_cp && last > max_cp)
+		last = max_cp;
+
+	int ret = diff_mapping(path, fast, ref, last);
+	if (!ret)
+		ret = diff_text(path, fast, ref, last);
+
+	doc_close(fast);
+	doc_close(ref);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long max_cp = 0;
+	int opt;
+	while ((opt = getopt(argc, argv, "n:h")) != -1) {
+		switch (opt) {
+			case 'n': max_cp = strtoul(optarg, NULL, 10); break;
+			default:
+				fprintf(stderr,
+						"Usage: %s [-n max_cp] file.doc ...\n", argv[0]);
+				return 1;
+		}
+	}
+	if (optind == argc){
+		fprintf(stderr,
+				"Usage: %s [-n max_cp] file.doc ...\n", argv[0]);
+		return 1;
+	}
+
+	doc_set_log(DOC_LOG_NONE, NULL, NULL);
+
+	int ret = 0, i;
+	for (i = optind; i < argc; ++i) {
+		if (difftest(argv[i], max_cp))
+			ret = 1;
+		fflush(stdout);
+	}
+	return ret;
+}
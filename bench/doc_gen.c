@@ -0,0 +1,1210 @@
+/**
+ * File              : doc_gen.c
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+/* write synthetic MS-DOC (Word 97) file for benchmarks:
+ * text paragraphs with character runs, piece table with
+ * fast-saved fragmentation, ANSI and UTF-16 pieces, style
+ * chains, nested tables, inline pictures and floating 
+ * pictures (shapes). The same options and seed give the 
+ * same file.
+ *
+ * WordDocument stream: FIB, text of pieces, Sepx, ChpxFkp
+ * and PapxFkp pages. 1Table stream: STSH, Clx, PlcBteChpx,
+ * PlcBtePapx, PlcfSed, PlcfSpa and OfficeArtContent with 
+ * BLIP store of shapes (drawings of shapes are not 
+ * written - libdoc takes BLIP of shape by its index). 
+ * Data stream: PICFAndOfficeArtData of inline pictures. Streams are written to Compound File Binary
+ * container (version 3, 512-byte sectors) - each stream is
+ * padded to the mini stream cutoff, so mini stream is not
+ * used. */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "../include/libdoc/doc.h"
+#include "../include/libdoc/sprm.h"
+
+/* sprm from ispmd, fSpec, sgc and spra */
+#define SPRM(ismpd, fSpec, sgc, spra) \
+	((ismpd) | (fSpec) << 9 | (sgc) << 10 | (spra) << 13)
+
+/* growing byte buffer for stream */
+struct buf {
+	BYTE *p;
+	size_t len;
+	size_t cap;
+};
+
+static size_t buf_reserve(struct buf *b, size_t n)
+{
+	if (b->len + n > b->cap){
+		size_t cap = b->cap ? b->cap : 4096;
+		while (cap < b->len + n)
+			cap *= 2;
+		b->p = realloc(b->p, cap);
+		if (!b->p){
+			perror("realloc");
+			exit(1);
+		}
+		memset(b->p + b->cap, 0, cap - b->cap);
+		b->cap = cap;
+	}
+	size_t off = b->len;
+	b->len += n;
+	return off;
+}
+
+static void buf_put(struct buf *b, const void *data, size_t n)
+{
+	size_t off = buf_reserve(b, n);
+	memcpy(b->p + off, data, n);
+}
+
+static void set16(BYTE *p, USHORT v)
+{
+	p[0] = v; p[1] = v >> 8;
+}
+
+static void set32(BYTE *p, ULONG v)
+{
+	p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static void buf_u8(struct buf *b, BYTE v)
+{
+	buf_put(b, &v, 1);
+}
+
+static void buf_u16(struct buf *b, USHORT v)
+{
+	size_t off = buf_reserve(b, 2);
+	set16(b->p + off, v);
+}
+
+static void buf_u32(struct buf *b, ULONG v)
+{
+	size_t off = buf_reserve(b, 4);
+	set32(b->p + off, v);
+}
+
+static void buf_align(struct buf *b, size_t a)
+{
+	if (b->len % a)
+		buf_reserve(b, a - b->len % a);
+}
+
+/* options */
+static struct {
+	int paragraphs;   // text paragraphs
+	int paraLen;      // characters in text paragraph
+	int pieces;       // pieces of piece table
+	int runLen;       // characters in character run
+	int styles;       // paragraph styles
+	int styleDepth;   // length of istdBase chains
+	int tables;       // tables between paragraphs
+	int rows;         // rows of table
+	int cols;         // columns of table
+	int nesting;      // depth of nested tables
+	int pictures;     // inline pictures
+	int shapes;       // floating pictures
+	int pictureSize;  // bytes of picture data
+	int unicode;      // percent of UTF-16 pieces
+	ULONG seed;
+	const char *output;
+} opt = {
+	.paragraphs  = 100,
+	.paraLen     = 200,
+	.pieces      = 1,
+	.runLen      = 50,
+	.styles      = 4,
+	.styleDepth  = 2,
+	.tables      = 0,
+	.rows        = 3,
+	.cols        = 3,
+	.nesting     = 1,
+	.pictures    = 0,
+	.shapes      = 0,
+	.pictureSize = 1024,
+	.unicode     = 0,
+	.seed        = 1,
+};
+
+/* xorshift32 - the same sequence on every platform */
+static ULONG _rand()
+{
+	opt.seed ^= opt.seed << 13;
+	opt.seed ^= opt.seed >> 17;
+	opt.seed ^= opt.seed << 5;
+	return opt.seed;
+}
+
+/* grpprl of PapxInFkp or Chpx shared by runs */
+struct prop {
+	BYTE data[32];
+	int len;
+};
+
+/* document as array of CP */
+static struct {
+	USHORT *text;     // character at CP
+	int *chp;         // index of Chpx at CP (0 - none)
+	int *pap;         // index of GrpPrlAndIstd at paragraph
+	                  // mark (-1 - not a mark)
+	CP n;
+	CP cap;
+
+	struct prop *chpx;
+	int nchpx;
+	struct prop *papx;
+	int npapx;
+
+	struct buf Data;  // pictures
+	CP *shapes;       // CP of floating pictures
+	int nshapes;
+} doc;
+
+enum {
+	CHPX_NONE,
+	CHPX_BOLD,
+	CHPX_PICTURE     // first picture, one Chpx for each 
+	                 // picture and one for all shapes
+};
+
+static int prop_add(struct prop **a, int *n,
+		const BYTE *data, int len, int dedup)
+{
+	int i;
+	for (i = 0; dedup && i < *n; ++i)
+		if ((*a)[i].len == len && !memcmp((*a)[i].data, data, len))
+			return i;
+
+	*a = realloc(*a, (*n + 1) * sizeof(struct prop));
+	if (!*a){
+		perror("realloc");
+		exit(1);
+	}
+	memcpy((*a)[*n].data, data, len);
+	(*a)[*n].len = len;
+	return (*n)++;
+}
+
+static void emit(USHORT ch, int chp, int pap)
+{
+	if (doc.n == doc.cap){
+		doc.cap = doc.cap ? doc.cap * 2 : 4096;
+		doc.text = realloc(doc.text, doc.cap * sizeof(USHORT));
+		doc.chp  = realloc(doc.chp,  doc.cap * sizeof(int));
+		doc.pap  = realloc(doc.pap,  doc.cap * sizeof(int));
+		if (!doc.text || !doc.chp || !doc.pap){
+			perror("realloc");
+			exit(1);
+		}
+	}
+	doc.text[doc.n] = ch;
+	doc.chp[doc.n]  = chp;
+	doc.pap[doc.n]  = pap;
+	doc.n++;
+}
+
+/* character run of CP */
+static int run_chp()
+{
+	return (doc.n / opt.runLen) % 2 ? CHPX_BOLD : CHPX_NONE;
+}
+
+static void emit_words(int n)
+{
+	int i, w = 0;
+	for (i = 0; i < n; ++i) {
+		if (w == 0){
+			w = 1 + _rand() % 8;
+			if (i > 0){
+				emit(' ', run_chp(), -1);
+				continue;
+			}
+		}
+		emit('a' + _rand() % 26, run_chp(), -1);
+		w--;
+	}
+}
+
+/* GrpPrlAndIstd of paragraph */
+static int papx_add(USHORT istd, int itap, int cell, int row)
+{
+	BYTE g[32];
+	int n = 0;
+	set16(&g[n], istd); n += 2;
+	if (itap){
+		set16(&g[n], SPRM(sprmPFInTable, 0, sgcPar, 1)); n += 2;
+		g[n++] = 1;
+		set16(&g[n], SPRM(sprmPItap, 1, sgcPar, 3)); n += 2;
+		set32(&g[n], itap); n += 4;
+		if (itap > 1 && cell){
+			set16(&g[n], SPRM(sprmPFInnerTableCell, 0, sgcPar, 1));
+			n += 2;
+			g[n++] = 1;
+		}
+		if (itap > 1 && row){
+			set16(&g[n], SPRM(sprmPFInnerTtp, 0, sgcPar, 1)); n += 2;
+			g[n++] = 1;
+		}
+		if (itap == 1 && row){
+			set16(&g[n], SPRM(sprmPFTtp, 0, sgcPar, 1)); n += 2;
+			g[n++] = 1;
+		}
+	}
+	return prop_add(&doc.papx, &doc.npapx, g, n, 1);
+}
+
+/* size of OfficeArtFBSE record with embedded PNG BLIP */
+static ULONG fbse_size()
+{
+	ULONG len = opt.pictureSize < 33 ? 33 : opt.pictureSize;
+	return 2 * OfficeArtRecordHeaderSize + 36 + 17 + len;
+}
+
+/* OfficeArtFBSE with embedded PNG BLIP of picture index */
+static void put_fbse(struct buf *b, int index)
+{
+	ULONG len = opt.pictureSize < 33 ? 33 : opt.pictureSize;
+	ULONG blip = OfficeArtRecordHeaderSize + 17 + len;
+	ULONG fbse = fbse_size();
+	struct OfficeArtRecordHeader rh;
+
+	// MD4 is not needed - UID only has to be unique
+	BYTE uid[16];
+	int i;
+	for (i = 0; i < 16; ++i)
+		uid[i] = (index * 131 + i * 7 + (index >> 8)) & 0xFF;
+	set32(uid, index + 1);
+
+	// OfficeArtFBSE
+	rh.recVer_recInstance = 0x2 | 6 << 4;   // msoblipPNG
+	rh.recType = OfficeArtRecTypeOfficeArtFBSE;
+	rh.recLen = fbse - OfficeArtRecordHeaderSize;
+	buf_put(b, &rh, OfficeArtRecordHeaderSize);
+	buf_u8(b, 6);                   // btWin32
+	buf_u8(b, 6);                   // btMacOS
+	buf_put(b, uid, 16);
+	buf_u16(b, 0xFF);               // tag
+	buf_u32(b, blip);               // size
+	buf_u32(b, 1);                  // cRef
+	buf_u32(b, 0);                  // foDelay
+	buf_u32(b, 0);                  // unused1, cbName, unused2,
+	                                // unused3
+
+	// OfficeArtBlipPNG
+	rh.recVer_recInstance = 0x6E0 << 4;
+	rh.recType = OfficeArtRecTypeOfficeArtBlipPNG;
+	rh.recLen = blip - OfficeArtRecordHeaderSize;
+	buf_put(b, &rh, OfficeArtRecordHeaderSize);
+	buf_put(b, uid, 16);
+	buf_u8(b, 0xFF);                // tag
+
+	// PNG signature and IHDR, the rest is zero
+	static const BYTE png[16] = {
+		0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n',
+		0, 0, 0, 13, 'I', 'H', 'D', 'R'
+	};
+	size_t off = buf_reserve(b, len);
+	memcpy(b->p + off, png, 16);
+	BYTE *w = b->p + off + 16;
+	w[0] = 0; w[1] = 0; w[2] = 0; w[3] = 64;    // width
+	w[4] = 0; w[5] = 0; w[6] = 0; w[7] = 48;    // height
+	w[8] = 8; w[9] = 2;                         // depth, RGB
+}
+
+/* PICFAndOfficeArtData with PNG BLIP in Data stream -
+ * return Chpx of picture */
+static int emit_picture(int index)
+{
+	struct buf *b = &doc.Data;
+	buf_align(b, 4);
+	ULONG loc = b->len;
+
+	// PICF
+	size_t off = buf_reserve(b, 68);
+	set32(b->p + off, 68 + OfficeArtRecordHeaderSize + fbse_size());
+	set16(b->p + off + 4, 0x44);        // cbHeader
+	set16(b->p + off + 6, MM_SHAPE);    // mfpf.mm
+	set16(b->p + off + 28, 1440);       // dxaGoal
+	set16(b->p + off + 30, 1440);       // dyaGoal
+	set16(b->p + off + 32, 1000);       // mx
+	set16(b->p + off + 34, 1000);       // my
+
+	// OfficeArtSpContainer without shape properties
+	struct OfficeArtRecordHeader rh;
+	rh.recVer_recInstance = 0xF;
+	rh.recType = OfficeArtRecTypeOfficeArtSpContainer;
+	rh.recLen = 0;
+	buf_put(b, &rh, OfficeArtRecordHeaderSize);
+	put_fbse(b, index);
+
+	// sprmCFSpec and sprmCPicLocation
+	BYTE g[9];
+	set16(&g[0], SPRM(sprmCFSpec, 0, sgcCha, 0));
+	g[2] = 1;
+	set16(&g[3], SPRM(sprmCPicLocation, 1, sgcCha, 3));
+	set32(&g[5], loc);
+	return prop_add(&doc.chpx, &doc.nchpx, g, 9, 0);
+}
+
+/* anchor of floating picture - return Chpx of shape */
+static int emit_shape()
+{
+	static int chpx = -1;
+	if (chpx < 0){
+		// sprmCFSpec
+		BYTE g[3];
+		set16(&g[0], SPRM(sprmCFSpec, 0, sgcCha, 0));
+		g[2] = 1;
+		chpx = prop_add(&doc.chpx, &doc.nchpx, g, 3, 0);
+	}
+	doc.shapes = realloc(doc.shapes, 
+			(doc.nshapes + 1) * sizeof(CP));
+	if (!doc.shapes){
+		perror("realloc");
+		exit(1);
+	}
+	doc.shapes[doc.nshapes++] = doc.n;
+	return chpx;
+}
+
+/* table of rows x cols at depth itap - first cell of each
+ * row has nested table while depth is less than nesting */
+static void emit_table(int itap)
+{
+	int r, c;
+	int cell = papx_add(0, itap, 1, 0);
+	int row  = papx_add(0, itap, 1, 1);
+	USHORT mark = itap == 1 ? 0x07 : 0x0D;
+	for (r = 0; r < opt.rows; ++r) {
+		for (c = 0; c < opt.cols; ++c) {
+			if (c == 0 && itap < opt.nesting)
+				emit_table(itap + 1);
+			emit_words(4 + _rand() % 12);
+			emit(mark, run_chp(), cell);
+		}
+		emit(mark, run_chp(), row);
+	}
+}
+
+static void emit_document()
+{
+	int p, t = 0, k = 0, s = 0;
+	for (p = 0; p < opt.paragraphs; ++p) {
+		// pictures at start of paragraphs
+		while (k < opt.pictures &&
+				(long)k * opt.paragraphs / opt.pictures <= p)
+		{
+			emit(INLINE_PICTURE, emit_picture(k), -1);
+			k++;
+		}
+		while (s < opt.shapes &&
+				(long)s * opt.paragraphs / opt.shapes <= p)
+		{
+			emit(FLOATING_PICTURE, emit_shape(), -1);
+			s++;
+		}
+
+		emit_words(opt.paraLen);
+		emit(0x0D, run_chp(),
+				papx_add(p % opt.styles, 0, 0, 0));
+
+		// tables in gaps between paragraphs - document ends
+		// with text paragraph
+		while (t < opt.tables && p + 1 < opt.paragraphs &&
+				(long)t * (opt.paragraphs - 1) / opt.tables <= p)
+		{
+			emit_table(1);
+			t++;
+		}
+	}
+}
+
+/* STSH with paragraph styles: style is based on previous
+ * one, chains have styleDepth styles */
+static void write_STSH(struct buf *b)
+{
+	// LPStshi
+	buf_u16(b, 20);                  // cbStshi
+	buf_u16(b, opt.styles);          // cstd
+	buf_u16(b, 0x000A);              // cbSTDBaseInFile
+	buf_u16(b, 1);                   // fStdStylenamesWritten
+	buf_u16(b, 0x5B);                // stiMaxWhenSaved
+	buf_u16(b, 0x0F);                // istdMaxFixedWhenSaved
+	buf_u16(b, 0);                   // nVerBuiltInNamesWhenSaved
+	buf_u16(b, 0);                   // ftcAsci
+	buf_u16(b, 0);                   // ftcFE
+	buf_u16(b, 0);                   // ftcOther
+	buf_u16(b, 0);                   // ftcBi
+
+	int istd;
+	for (istd = 0; istd < opt.styles; ++istd) {
+		USHORT base = istd % opt.styleDepth ? istd - 1 : 0x0FFF;
+		char name[32];
+		if (istd == 0)
+			strcpy(name, "Normal");
+		else
+			sprintf(name, "Style %d", istd);
+		int i, cch = strlen(name);
+
+		size_t lp = buf_reserve(b, 2);  // cbStd
+		size_t start = b->len;
+
+		// StdfBase
+		buf_u16(b, istd ? 0x0FFE : 0);  // sti
+		buf_u16(b, 1 | base << 4);      // stkPar, istdBase
+		buf_u16(b, 2 | 0 << 4);         // cupx, istdNext
+		buf_u16(b, 0);                  // bchUpe
+		buf_u16(b, 0);                  // grfstd
+
+		// xstzName
+		buf_u16(b, cch);
+		for (i = 0; i < cch; ++i)
+			buf_u16(b, name[i]);
+		buf_u16(b, 0);
+
+		// LPUpxPapx: istd and sprmPJc80
+		buf_u16(b, 5);
+		buf_u16(b, istd);
+		buf_u16(b, SPRM(sprmPJc80, 0, sgcPar, 1));
+		buf_u8(b, istd % 3);
+		buf_align(b, 2);
+
+		// LPUpxChpx: sprmCHps - font size grows with depth
+		buf_u16(b, 4);
+		buf_u16(b, SPRM(sprmCHps, 1, sgcCha, 2));
+		buf_u16(b, 20 + 2 * (istd % opt.styleDepth));
+
+		set16(b->p + lp, b->len - start);
+	}
+}
+
+/* piece of text in WordDocument stream */
+struct piece {
+	CP cp;            // first CP
+	CP ncp;           // number of CP
+	int unicode;      // UTF-16
+	ULONG fc;         // offset of text in stream
+};
+
+static int piece_cp_compare(const void *a, const void *b)
+{
+	const CP *x = a, *y = b;
+	return (*x > *y) - (*x < *y);
+}
+
+/* split text to pieces - return number of pieces */
+static int split_pieces(struct piece **out)
+{
+	int i, n = opt.pieces;
+	if (n > doc.n)
+		n = doc.n;
+
+	// n - 1 distinct cut points
+	CP *cut = malloc((n + 1) * sizeof(CP));
+	if (!cut){
+		perror("malloc");
+		exit(1);
+	}
+	cut[0] = 0;
+	for (i = 1; i < n; ++i)
+		cut[i] = 1 + _rand() % (doc.n - 1);
+	qsort(cut + 1, n - 1, sizeof(CP), piece_cp_compare);
+	int k = 1;
+	for (i = 1; i < n; ++i)
+		if (cut[i] != cut[k-1])
+			cut[k++] = cut[i];
+	n = k;
+	cut[n] = doc.n;
+
+	struct piece *p = calloc(n, sizeof(struct piece));
+	if (!p){
+		perror("calloc");
+		exit(1);
+	}
+	for (i = 0; i < n; ++i) {
+		p[i].cp  = cut[i];
+		p[i].ncp = cut[i+1] - cut[i];
+		p[i].unicode = (int)(_rand() % 100) < opt.unicode;
+	}
+	free(cut);
+	*out = p;
+	return n;
+}
+
+/* run of bytes in WordDocument stream with Chpx or
+ * GrpPrlAndIstd */
+struct run {
+	ULONG fc;
+	int prop;
+};
+
+static void run_add(struct run **a, int *n, int *cap,
+		ULONG fc, int prop)
+{
+	if (*n == *cap){
+		*cap = *cap ? *cap * 2 : 1024;
+		*a = realloc(*a, *cap * sizeof(struct run));
+		if (!*a){
+			perror("realloc");
+			exit(1);
+		}
+	}
+	(*a)[*n].fc = fc;
+	(*a)[*n].prop = prop;
+	(*n)++;
+}
+
+/* ChpxFkp pages for runs [fc, next fc) - pages are
+ * appended to b, PlcBteChpx to t */
+static void write_ChpxFkp(struct buf *b, struct buf *t,
+		struct run *r, int n, ULONG fcEnd)
+{
+	int i = 0, k, npages = 0;
+	ULONG *aFc = NULL, *aPn = NULL;
+	while (i < n) {
+		size_t page = buf_reserve(b, 512);
+		BYTE *p = b->p + page;
+		int top = 511, crun = 0;
+		BYTE pos[512];   // position of Chpx in page
+		memset(pos, 0, sizeof(pos));
+		int first = i;
+		BYTE *rgb = malloc(n - first);
+
+		while (i < n && crun < 0x65) {
+			struct prop *c = &doc.chpx[r[i].prop];
+			int need = 0, at = 0;
+			if (r[i].prop != CHPX_NONE){
+				// Chpx already in page
+				for (k = first; k < i; ++k)
+					if (r[k].prop == r[i].prop)
+						break;
+				if (k < i)
+					at = rgb[k - first];
+				else
+					need = c->len + 1 + 1;
+			}
+			int newtop = need ? ((top - c->len - 1) & ~1) : top;
+			if (4 * (crun + 2) + crun + 1 > newtop)
+				break;
+			if (need){
+				top = newtop;
+				p[top] = c->len;
+				memcpy(&p[top + 1], c->data, c->len);
+				at = top / 2;
+			}
+			rgb[crun++] = at;
+			i++;
+		}
+
+		// rgfc and rgb
+		for (k = 0; k < crun; ++k)
+			set32(&p[4 * k], r[first + k].fc);
+		set32(&p[4 * crun], i < n ? r[i].fc : fcEnd);
+		memcpy(&p[4 * (crun + 1)], rgb, crun);
+		p[511] = crun;
+		free(rgb);
+
+		aFc = realloc(aFc, (npages + 2) * sizeof(ULONG));
+		aPn = realloc(aPn, (npages + 1) * sizeof(ULONG));
+		aFc[npages] = r[first].fc;
+		aPn[npages] = page / 512;
+		npages++;
+	}
+	aFc[npages] = fcEnd;
+
+	for (k = 0; k <= npages; ++k)
+		buf_u32(t, aFc[k]);
+	for (k = 0; k < npages; ++k)
+		buf_u32(t, aPn[k]);
+	free(aFc);
+	free(aPn);
+}
+
+/* PapxFkp pages for runs [fc, next fc) */
+static void write_PapxFkp(struct buf *b, struct buf *t,
+		struct run *r, int n, ULONG fcEnd)
+{
+	int i = 0, k, npages = 0;
+	ULONG *aFc = NULL, *aPn = NULL;
+	while (i < n) {
+		size_t page = buf_reserve(b, 512);
+		BYTE *p = b->p + page;
+		int top = 511, cpara = 0;
+		int first = i;
+		BYTE *bx = malloc(n - first);
+
+		while (i < n && cpara < 0x1D) {
+			struct prop *c = &doc.papx[r[i].prop];
+			for (k = first; k < i; ++k)
+				if (r[k].prop == r[i].prop)
+					break;
+
+			// PapxInFkp: cb and grpprlInPapx of 2*cb-1 bytes,
+			// or 0, cb' and grpprlInPapx of 2*cb' bytes
+			int head = c->len % 2 ? 1 : 2;
+			int newtop = k < i ? top :
+				((top - head - c->len) & ~1);
+			if (4 * (cpara + 2) + 13 * (cpara + 1) > newtop)
+				break;
+			if (k < i)
+				bx[cpara] = bx[k - first];
+			else {
+				top = newtop;
+				if (head == 1)
+					p[top] = (c->len + 1) / 2;
+				else {
+					p[top] = 0;
+					p[top + 1] = c->len / 2;
+				}
+				memcpy(&p[top + head], c->data, c->len);
+				bx[cpara] = top / 2;
+			}
+			cpara++;
+			i++;
+		}
+
+		// rgfc and rgbx
+		for (k = 0; k < cpara; ++k)
+			set32(&p[4 * k], r[first + k].fc);
+		set32(&p[4 * cpara], i < n ? r[i].fc : fcEnd);
+		for (k = 0; k < cpara; ++k)
+			p[4 * (cpara + 1) + 13 * k] = bx[k];
+		p[511] = cpara;
+		free(bx);
+
+		aFc = realloc(aFc, (npages + 2) * sizeof(ULONG));
+		aPn = realloc(aPn, (npages + 1) * sizeof(ULONG));
+		aFc[npages] = r[first].fc;
+		aPn[npages] = page / 512;
+		npages++;
+	}
+	aFc[npages] = fcEnd;
+
+	for (k = 0; k <= npages; ++k)
+		buf_u32(t, aFc[k]);
+	for (k = 0; k < npages; ++k)
+		buf_u32(t, aPn[k]);
+	free(aFc);
+	free(aPn);
+}
+
+/* WordDocument and 1Table streams */
+static void write_streams(struct buf *w, struct buf *t)
+{
+	int i, j;
+	struct piece *pc;
+	int npc = split_pieces(&pc);
+
+	// physical order of pieces - fast save appends pieces
+	// out of order, piece with last paragraph mark is last
+	int *order = malloc(npc * sizeof(int));
+	for (i = 0; i < npc; ++i)
+		order[i] = i;
+	for (i = npc - 2; i > 0; --i) {
+		j = _rand() % (i + 1);
+		int x = order[i]; order[i] = order[j]; order[j] = x;
+	}
+
+	// FIB is written at the end, text starts at 0x400
+	buf_reserve(w, 0x400);
+	ULONG fcMin = w->len;
+
+	struct run *chpx = NULL, *papx = NULL;
+	int nchpx = 0, cchpx = 0, npapx = 0, cpapx = 0;
+	ULONG paraFc = fcMin;    // start of next paragraph run
+	int inPara = 0;
+	for (i = 0; i < npc; ++i) {
+		struct piece *p = &pc[order[i]];
+		if (p->unicode)
+			buf_align(w, 2);
+		p->fc = w->len;
+		CP cp;
+		for (cp = p->cp; cp < p->cp + p->ncp; ++cp) {
+			ULONG fc = w->len;
+			USHORT ch = doc.text[cp];
+			if (p->unicode){
+				// Cyrillic letters in UTF-16 pieces
+				if (ch >= 'a' && ch <= 'z')
+					ch = 0x0430 + ch - 'a';
+				buf_u16(w, ch);
+			} else
+				buf_u8(w, ch);
+
+			if (nchpx == 0 || chpx[nchpx-1].prop != doc.chp[cp])
+				run_add(&chpx, &nchpx, &cchpx, fc, doc.chp[cp]);
+
+			// paragraph run ends right after paragraph mark
+			if (!inPara){
+				run_add(&papx, &npapx, &cpapx, paraFc, 0);
+				inPara = 1;
+			}
+			if (doc.pap[cp] >= 0){
+				papx[npapx-1].prop = doc.pap[cp];
+				paraFc = w->len;
+				inPara = 0;
+			}
+		}
+	}
+	ULONG fcMac = w->len;
+
+	// Sepx: sprmSCcolumns
+	buf_align(w, 2);
+	ULONG fcSepx = w->len;
+	buf_u16(w, 4);
+	buf_u16(w, SPRM(sprmSCcolumns, 0, sgcSec, 2));
+	buf_u16(w, 0);
+
+	// FKP pages
+	buf_align(w, 512);
+	FibRgFcLcb97 fc;
+	memset(&fc, 0, sizeof(fc));
+
+	write_STSH(t);
+	fc.lcbStshf = t->len - fc.fcStshf;
+
+	fc.fcPlcfBteChpx = t->len;
+	write_ChpxFkp(w, t, chpx, nchpx, fcMac);
+	fc.lcbPlcfBteChpx = t->len - fc.fcPlcfBteChpx;
+
+	fc.fcPlcfBtePapx = t->len;
+	write_PapxFkp(w, t, papx, npapx, fcMac);
+	fc.lcbPlcfBtePapx = t->len - fc.fcPlcfBtePapx;
+
+	// Clx: Pcdt with PlcPcd
+	fc.fcClx = t->len;
+	buf_u8(t, 0x02);
+	buf_u32(t, (npc + 1) * 4 + npc * 8);
+	for (i = 0; i < npc; ++i)
+		buf_u32(t, pc[i].cp);
+	buf_u32(t, doc.n);
+	for (i = 0; i < npc; ++i) {
+		buf_u16(t, 0);
+		buf_u32(t, pc[i].unicode ? pc[i].fc :
+				(pc[i].fc * 2) | 0x40000000);
+		buf_u16(t, 0);
+	}
+	fc.lcbClx = t->len - fc.fcClx;
+
+	// PlcfSed with one section
+	fc.fcPlcfSed = t->len;
+	buf_u32(t, 0);
+	buf_u32(t, doc.n);
+	buf_u16(t, 0);
+	buf_u32(t, fcSepx);
+	buf_u16(t, 0);
+	buf_u32(t, 0xFFFFFFFF);
+	fc.lcbPlcfSed = t->len - fc.fcPlcfSed;
+
+	if (doc.nshapes){
+		// PlcfSpa - last CP is after main document
+		fc.fcPlcSpaMom = t->len;
+		for (i = 0; i < doc.nshapes; ++i)
+			buf_u32(t, doc.shapes[i]);
+		buf_u32(t, doc.n + 1);
+		for (i = 0; i < doc.nshapes; ++i) {
+			buf_u32(t, 0x0401 + i);       // lid
+			buf_u32(t, 0);                // rca
+			buf_u32(t, 0);
+			buf_u32(t, 1440);
+			buf_u32(t, 1440);
+			buf_u16(t, 0);                // fHdr ... fAnchorLock
+			buf_u32(t, 0);                // cTxbx
+		}
+		fc.lcbPlcSpaMom = t->len - fc.fcPlcSpaMom;
+
+		// OfficeArtContent: OfficeArtDggContainer with 
+		// OfficeArtFDGGBlock and BLIP store in order of 
+		// shapes
+		ULONG store = doc.nshapes * fbse_size();
+		struct OfficeArtRecordHeader rh;
+		fc.fcDggInfo = t->len;
+		rh.recVer_recInstance = 0xF;
+		rh.recType = OfficeArtRecTypeOfficeArtDggContainer;
+		rh.recLen = 2 * OfficeArtRecordHeaderSize + 16 + store;
+		buf_put(t, &rh, OfficeArtRecordHeaderSize);
+		
+		rh.recVer_recInstance = 0;
+		rh.recType = OfficeArtRecTypeOfficeArtFDggBlock;
+		rh.recLen = 16;
+		buf_put(t, &rh, OfficeArtRecordHeaderSize);
+		buf_u32(t, 0x0400 + doc.nshapes + 1);    // spidMax
+		buf_u32(t, 1);                           // cidcl
+		buf_u32(t, doc.nshapes);                 // cspSaved
+		buf_u32(t, 0);                           // cdgSaved
+		
+		rh.recVer_recInstance = 0xF | doc.nshapes << 4;
+		rh.recType = OfficeArtRecTypeOfficeArtBStoreContainer;
+		rh.recLen = store;
+		buf_put(t, &rh, OfficeArtRecordHeaderSize);
+		for (i = 0; i < doc.nshapes; ++i)
+			put_fbse(t, opt.pictures + i);
+		fc.lcbDggInfo = t->len - fc.fcDggInfo;
+	}
+
+	// FIB
+	BYTE *f = w->p;
+	set16(f + 0,  0xA5EC);             // wIdent
+	set16(f + 2,  0x00C1);             // nFib
+	set16(f + 6,  0x0409);             // lid
+	set16(f + 10, 0x0200 |             // fWhichTblStm
+			(npc > 1 ? 0x0004 : 0));       // fComplex
+	set16(f + 12, 0x00BF);             // nFibBack
+	int off = 32;
+	set16(f + off, 14); off += 2;      // csw
+	off += sizeof(FibRgW97);
+	set16(f + off, 22); off += 2;      // cslw
+	FibRgLw97 lw;
+	memset(&lw, 0, sizeof(lw));
+	lw.cbMac = w->len;
+	lw.ccpText = doc.n;
+	memcpy(f + off, &lw, sizeof(lw)); off += sizeof(lw);
+	set16(f + off, sizeof(fc) / 8); off += 2;  // cbRgFcLcb
+	memcpy(f + off, &fc, sizeof(fc)); off += sizeof(fc);
+	set16(f + off, 0);                 // cswNew
+
+	if (fcMin < off + 2){
+		fprintf(stderr, "FIB does not fit\n");
+		exit(1);
+	}
+
+	free(order);
+	free(pc);
+	free(chpx);
+	free(papx);
+}
+
+/* Compound File Binary */
+#define CFB_SECTOR     512
+#define CFB_FREESECT   0xFFFFFFFF
+#define CFB_ENDOFCHAIN 0xFFFFFFFE
+#define CFB_FATSECT    0xFFFFFFFD
+#define CFB_DIFSECT    0xFFFFFFFC
+#define CFB_NOSTREAM   0xFFFFFFFF
+#define CFB_MINICUTOFF 4096
+
+struct cfb_stream {
+	const char *name;
+	struct buf *b;
+	ULONG start;
+	ULONG nsec;
+};
+
+static void dir_entry(BYTE *e, const char *name, BYTE type,
+		BYTE color, ULONG left, ULONG right, ULONG child,
+		ULONG start, ULONG size)
+{
+	int i, n = strlen(name);
+	memset(e, 0, 128);
+	for (i = 0; i < n; ++i)
+		set16(e + 2 * i, name[i]);
+	set16(e + 64, (n + 1) * 2);
+	e[66] = type;
+	e[67] = color;
+	set32(e + 68, left);
+	set32(e + 72, right);
+	set32(e + 76, child);
+	set32(e + 116, start);
+	set32(e + 120, size);
+}
+
+/* CFB order of names in directory: shorter name is less, 
+ * names of the same length are compared uppercase */
+static int dir_compare(const char *a, const char *b)
+{
+	size_t la = strlen(a), lb = strlen(b);
+	if (la != lb)
+		return la < lb ? -1 : 1;
+	return strcasecmp(a, b);
+}
+
+/* link entries of sorted ids [lo, hi) to balanced tree and
+ * return id of root. Levels above bottom are full, so 
+ * nodes of incomplete bottom level are red */
+static ULONG dir_tree(const ULONG *id, int lo, int hi, int depth,
+		int bottom, ULONG *left, ULONG *right, BYTE *color)
+{
+	if (lo >= hi)
+		return CFB_NOSTREAM;
+	int mid = lo + (hi - lo) / 2;
+	ULONG e = id[mid];
+	left[e]  = dir_tree(id, lo, mid, depth + 1, bottom, 
+			left, right, color);
+	right[e] = dir_tree(id, mid + 1, hi, depth + 1, bottom, 
+			left, right, color);
+	color[e] = depth == bottom ? 0 : 1;
+	return e;
+}
+
+static int write_cfb(FILE *fp, struct cfb_stream *s, int n)
+{
+	int i;
+	ULONG sec = 0;
+	for (i = 0; i < n; ++i) {
+		// streams below cutoff would be in mini stream
+		if (s[i].b->len < CFB_MINICUTOFF)
+			buf_reserve(s[i].b, CFB_MINICUTOFF - s[i].b->len);
+		s[i].nsec = (s[i].b->len + CFB_SECTOR - 1) / CFB_SECTOR;
+		sec += s[i].nsec;
+	}
+	sec += 1;  // directory
+
+	// FAT and DIFAT sectors
+	ULONG nfat = 0, ndif = 0, m;
+	do {
+		m = nfat;
+		nfat = (sec + nfat + ndif + 127) / 128;
+		ndif = nfat > 109 ? (nfat - 109 + 126) / 127 : 0;
+	} while (m != nfat);
+
+	ULONG *fat = malloc(nfat * 128 * sizeof(ULONG));
+	if (!fat){
+		perror("malloc");
+		return -1;
+	}
+	for (i = 0; i < nfat * 128; ++i)
+		fat[i] = CFB_FREESECT;
+
+	ULONG k = 0;
+	for (i = 0; i < nfat; ++i)
+		fat[k++] = CFB_FATSECT;
+	for (i = 0; i < ndif; ++i)
+		fat[k++] = CFB_DIFSECT;
+	ULONG dir = k;
+	fat[k++] = CFB_ENDOFCHAIN;
+	for (i = 0; i < n; ++i) {
+		s[i].start = k;
+		ULONG j;
+		for (j = 0; j < s[i].nsec; ++j, ++k)
+			fat[k] = j + 1 < s[i].nsec ? k + 1 : CFB_ENDOFCHAIN;
+	}
+
+	// header
+	BYTE h[CFB_SECTOR];
+	memset(h, 0, sizeof(h));
+	static const BYTE sig[8] =
+		{0xD0, 0xCF, 0x11, 0xE0, 0xA1, 0xB1, 0x1A, 0xE1};
+	memcpy(h, sig, 8);
+	set16(h + 24, 0x003E);           // minor version
+	set16(h + 26, 0x0003);           // major version
+	set16(h + 28, 0xFFFE);           // byte order
+	set16(h + 30, 9);                // sector shift
+	set16(h + 32, 6);                // mini sector shift
+	set32(h + 44, nfat);
+	set32(h + 48, dir);
+	set32(h + 56, CFB_MINICUTOFF);
+	set32(h + 60, CFB_ENDOFCHAIN);   // mini FAT
+	set32(h + 68, ndif ? nfat : CFB_ENDOFCHAIN);
+	set32(h + 72, ndif);
+	for (i = 0; i < 109; ++i)
+		set32(h + 76 + 4 * i, i < nfat ? i : CFB_FREESECT);
+	fwrite(h, CFB_SECTOR, 1, fp);
+
+	// FAT
+	BYTE sector[CFB_SECTOR];
+	for (i = 0; i < nfat; ++i) {
+		int j;
+		for (j = 0; j < 128; ++j)
+			set32(sector + 4 * j, fat[i * 128 + j]);
+		fwrite(sector, CFB_SECTOR, 1, fp);
+	}
+
+	// DIFAT
+	ULONG f = 109;
+	for (i = 0; i < ndif; ++i) {
+		int j;
+		for (j = 0; j < 127; ++j, ++f)
+			set32(sector + 4 * j, f < nfat ? f : CFB_FREESECT);
+		set32(sector + 508, i + 1 < ndif ? nfat + i + 1 :
+				CFB_ENDOFCHAIN);
+		fwrite(sector, CFB_SECTOR, 1, fp);
+	}
+
+	// directory: Root Entry and red-black tree of streams 
+	// (entry i + 1) sorted by dir_compare
+	ULONG id[3], left[4], right[4];
+	BYTE color[4];
+	for (i = 0; i < n; ++i) {
+		int j = i;
+		while (j > 0 && 
+				dir_compare(s[id[j-1] - 1].name, s[i].name) > 0)
+		{
+			id[j] = id[j-1];
+			j--;
+		}
+		id[j] = i + 1;
+	}
+	int depth = 0, full = 1;
+	while (full < n) {
+		full = full * 2 + 1;
+		depth++;
+	}
+	ULONG root = dir_tree(id, 0, n, 0, full == n ? -1 : depth,
+			left, right, color);
+
+	memset(sector, 0, sizeof(sector));
+	dir_entry(sector, "Root Entry", 5, 1, CFB_NOSTREAM,
+			CFB_NOSTREAM, root, CFB_ENDOFCHAIN, 0);
+	for (i = 0; i < 3; ++i) {
+		BYTE *e = sector + 128 * (i + 1);
+		if (i >= n){
+			dir_entry(e, "", 0, 0, CFB_NOSTREAM, CFB_NOSTREAM,
+					CFB_NOSTREAM, 0, 0);
+			continue;
+		}
+		dir_entry(e, s[i].name, 2, color[i + 1], 
+				left[i + 1], right[i + 1],
+				CFB_NOSTREAM, s[i].start, s[i].b->len);
+	}
+	fwrite(sector, CFB_SECTOR, 1, fp);
+
+	// streams
+	for (i = 0; i < n; ++i) {
+		buf_reserve(s[i].b, s[i].nsec * CFB_SECTOR - s[i].b->len);
+		fwrite(s[i].b->p, CFB_SECTOR, s[i].nsec, fp);
+	}
+
+	free(fat);
+	return ferror(fp) ? -1 : 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+			"Usage: %s [options] -o file.doc\n"
+			"  --paragraphs N        text paragraphs (%d)\n"
+			"  --paragraph-length N  characters in paragraph (%d)\n"
+			"  --pieces N            pieces of piece table - more\n"
+			"                        than 1 is fast-saved (%d)\n"
+			"  --run-length N        characters in run (%d)\n"
+			"  --styles N            paragraph styles (%d)\n"
+			"  --style-depth N       styles in istdBase chain (%d)\n"
+			"  --tables N            tables (%d)\n"
+			"  --rows N              rows of table (%d)\n"
+			"  --columns N           columns of table (%d)\n"
+			"  --nesting N           depth of nested tables (%d)\n"
+			"  --pictures N          inline pictures (%d)\n"
+			"  --shapes N            floating pictures (%d)\n"
+			"  --picture-size N      bytes of picture (%d)\n"
+			"  --unicode PERCENT     UTF-16 pieces (%d)\n"
+			"  --seed N              random seed (%lu)\n",
+			prog, opt.paragraphs, opt.paraLen, opt.pieces,
+			opt.runLen, opt.styles, opt.styleDepth, opt.tables,
+			opt.rows, opt.cols, opt.nesting, opt.pictures,
+			opt.shapes, opt.pictureSize, opt.unicode, (unsigned long)opt.seed);
+}
+
+int main(int argc, char *argv[])
+{
+	static struct option lopts[] = {
+		{"paragraphs",       required_argument, 0, 'p'},
+		{"paragraph-length", required_argument, 0, 'l'},
+		{"pieces",           required_argument, 0, 'f'},
+		{"run-length",       required_argument, 0, 'r'},
+		{"styles",           required_argument, 0, 's'},
+		{"style-depth",      required_argument, 0, 'd'},
+		{"tables",           required_argument, 0, 't'},
+		{"rows",             required_argument, 0, 'R'},
+		{"columns",          required_argument, 0, 'C'},
+		{"nesting",          required_argument, 0, 'n'},
+		{"pictures",         required_argument, 0, 'i'},
+		{"shapes",           required_argument, 0, 'a'},
+		{"picture-size",     required_argument, 0, 'z'},
+		{"unicode",          required_argument, 0, 'u'},
+		{"seed",             required_argument, 0, 'S'},
+		{"output",           required_argument, 0, 'o'},
+		{"help",             no_argument,       0, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	int c;
+	while ((c = getopt_long(argc, argv,
+					"p:l:f:r:s:d:t:R:C:n:i:a:z:u:S:o:h", lopts, NULL)) != -1)
+	{
+		switch (c) {
+			case 'p': opt.paragraphs  = atoi(optarg); break;
+			case 'l': opt.paraLen     = atoi(optarg); break;
+			case 'f': opt.pieces      = atoi(optarg); break;
+			case 'r': opt.runLen      = atoi(optarg); break;
+			case 's': opt.styles      = atoi(optarg); break;
+			case 'd': opt.styleDepth  = atoi(optarg); break;
+			case 't': opt.tables      = atoi(optarg); break;
+			case 'R': opt.rows        = atoi(optarg); break;
+			case 'C': opt.cols        = atoi(optarg); break;
+			case 'n': opt.nesting     = atoi(optarg); break;
+			case 'i': opt.pictures    = atoi(optarg); break;
+			case 'a': opt.shapes      = atoi(optarg); break;
+			case 'z': opt.pictureSize = atoi(optarg); break;
+			case 'u': opt.unicode     = atoi(optarg); break;
+			case 'S': opt.seed        = strtoul(optarg, NULL, 0); break;
+			case 'o': opt.output      = optarg; break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (!opt.output || optind != argc || opt.paragraphs < 1 ||
+			opt.paraLen < 0 || opt.pieces < 1 || opt.runLen < 1 ||
+			opt.styles < 1 || opt.styles > 0x0FFE ||
+			opt.styleDepth < 1 || opt.tables < 0 ||
+			(opt.tables && opt.paragraphs < 2) || opt.rows < 1 ||
+			opt.cols < 1 || opt.nesting < 1 || opt.pictures < 0 ||
+			opt.shapes < 0 || opt.shapes > 0x0FFF)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	if (opt.seed == 0)
+		opt.seed = 1;
+
+	// Chpx of runs without pictures
+	BYTE bold[3];
+	set16(bold, SPRM(sprmCFBold, 0, sgcCha, 0));
+	bold[2] = 1;
+	prop_add(&doc.chpx, &doc.nchpx, NULL, 0, 0);
+	prop_add(&doc.chpx, &doc.nchpx, bold, 3, 0);
+
+	emit_document();
+
+	struct buf w, t;
+	memset(&w, 0, sizeof(w));
+	memset(&t, 0, sizeof(t));
+	write_streams(&w, &t);
+
+	FILE *fp = fopen(opt.output, "wb");
+	if (!fp){
+		perror(opt.output);
+		return 1;
+	}
+	struct cfb_stream s[] = {
+		{"WordDocument", &w},
+		{"1Table",       &t},
+		{"Data",         &doc.Data},
+	};
+	int ret = write_cfb(fp, s, doc.Data.len ? 3 : 2);
+	if (fclose(fp) || ret){
+		perror(opt.output);
+		return 1;
+	}
+
+	free(w.p);
+	free(t.p);
+	free(doc.Data.p);
+	free(doc.shapes);
+	free(doc.text);
+	free(doc.chp);
+	free(doc.pap);
+	free(doc.chpx);
+	free(doc.papx);
+	return 0;
+}
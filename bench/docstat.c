@@ -0,0 +1,488 @@
+/**
+ * File              : docstat.c
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+/* structure statistics of .doc files in directory (and
+ * subdirectories) to decide which optimizations matter -
+ * one CSV row for each file, or distribution of each
+ * column with -s:
+ *   docstat [-j threads] [-s] dir
+ * Only FIB, piece table, PLCs, FKP pages, style sheet and
+ * OfficeArt headers are read - text is not decoded. Files
+ * are read in parallel by threads (default - number of
+ * CPU). Tables are counted in PAPX order: table starts
+ * where paragraph not in table is followed by paragraph in
+ * table */
+
+#define _GNU_SOURCE
+#include <ftw.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/libdoc/doc.h"
+#include "../include/libdoc/prl.h"
+#include "../include/libdoc/sprm.h"
+
+/* columns of CSV - value -1 is not known (structure can't
+ * be read) and is empty in CSV */
+#define COLUMNS \
+	X(bytes)             \
+	X(nFib)              \
+	X(fComplex)          \
+	X(cQuickSaves)       \
+	X(ccpText)           \
+	X(pieces)            \
+	X(compressed_pieces) \
+	X(compressed_pct)    \
+	X(chpx_pages)        \
+	X(chpx_runs)         \
+	X(runs_per_page)     \
+	X(papx_pages)        \
+	X(papx_runs)         \
+	X(styles)            \
+	X(style_depth)       \
+	X(sections)          \
+	X(table_paragraphs)  \
+	X(tables)            \
+	X(table_depth)       \
+	X(inline_pictures)   \
+	X(floating_pictures) \
+	X(blips)
+
+struct stat_row {
+#define X(name) double name;
+	COLUMNS
+#undef X
+};
+
+static const char *column_names[] = {
+#define X(name) #name,
+	COLUMNS
+#undef X
+};
+
+#define NCOLUMNS (sizeof(column_names)/sizeof(*column_names))
+
+/* files of directory */
+static struct {
+	char **path;
+	struct stat_row *row;
+	int n, cap;
+	int next;             // next file for thread (atomic)
+} files;
+
+static int add_file(const char *path, const struct stat *st,
+		int type, struct FTW *ftw)
+{
+	size_t len = strlen(path);
+	if (type != FTW_F || len < 4 ||
+			strcasecmp(path + len - 4, ".doc"))
+		return 0;
+
+	if (files.n == files.cap){
+		files.cap = files.cap ? files.cap * 2 : 64;
+		files.path = realloc(files.path, files.cap * sizeof(char *));
+		if (!files.path){
+			perror("realloc");
+			return -1;
+		}
+	}
+	files.path[files.n++] = strdup(path);
+	return 0;
+}
+
+static int path_compare(const void *a, const void *b)
+{
+	return strcmp(*(char **)a, *(char **)b);
+}
+
+/* piece table - number of pieces and share of CP in
+ * compressed (8-bit) pieces */
+static void stat_pieces(cfb_doc_t *doc, struct stat_row *r)
+{
+	struct PlcPcd *PlcPcd = doc_plcpcd(doc);
+	if (!PlcPcd || PlcPcd->aCPl < 1)
+		return;
+
+	int i, n = PlcPcd->aCPl - 1, compressed = 0;
+	double cp = 0, ccp = 0;
+	for (i = 0; i < n; ++i) {
+		double len = PlcPcd->aCp[i + 1] - PlcPcd->aCp[i];
+		cp += len;
+		if (FcCompressed(PlcPcd->aPcd[i].fc)){
+			compressed++;
+			ccp += len;
+		}
+	}
+	r->pieces = n;
+	r->compressed_pieces = compressed;
+	r->compressed_pct = cp > 0 ? ccp * 100 / cp : 0;
+}
+
+static int _chpx_cb(void *userdata, struct Prl *prl)
+{
+	int *pic = userdata;
+	if (SprmSgc(prl->sprm) != sgcCha)
+		return 0;
+	USHORT ismpd = SprmIspmd(prl->sprm);
+	if (ismpd == sprmCPicLocation && *pic == 0)
+		*pic = 1;
+	else if (ismpd == sprmCFData && prl->operand[0])
+		*pic = -1;   // NilPICFAndBinData is not a picture
+	return 0;
+}
+
+/* ChpxFkp pages - runs and inline pictures */
+static void stat_chpx(cfb_doc_t *doc, struct stat_row *r)
+{
+	struct PlcBteChpx *plcbteChpx = doc_plcbteChpx(doc);
+	if (!plcbteChpx)
+		return;
+
+	int i, j, runs = 0, pictures = 0;
+	int pages = doc->plcbteChpxNaFc - 1;
+	for (i = 0; i < pages; ++i) {
+		struct ChpxFkp chpxFkp;
+		BYTE buf[512];
+		memset(&chpxFkp, 0, sizeof(chpxFkp));
+		chpxFkp_init(&chpxFkp, buf, doc->WordDocument,
+				pnFkpChpx_pn(plcbteChpx->aPnBteChpx[i]) * 512);
+		runs += chpxFkp.crun;
+
+		for (j = 0; j < chpxFkp.crun; ++j) {
+			// Chpx is at rgb[j] * 2 in page - 0 is no Chpx
+			int off = chpxFkp.rgb[j] * 2;
+			if (off == 0 || off >= 511)
+				continue;
+			BYTE cb = buf[off];
+			if (off + 1 + cb > 511)
+				continue;
+			int pic = 0;
+			parse_grpprl(&buf[off + 1], cb, &pic, _chpx_cb);
+			if (pic > 0)
+				pictures++;
+		}
+	}
+	r->chpx_pages = pages;
+	r->chpx_runs = runs;
+	r->runs_per_page = pages ? (double)runs / pages : 0;
+	r->inline_pictures = pictures;
+}
+
+static int _papx_cb(void *userdata, struct Prl *prl)
+{
+	int *depth = userdata;
+	if (SprmSgc(prl->sprm) != sgcPar)
+		return 0;
+	USHORT ismpd = SprmIspmd(prl->sprm);
+	if (ismpd == sprmPFInTable && prl->operand[0] && *depth < 1)
+		*depth = 1;
+	else if (ismpd == sprmPItap)
+		*depth = *(LONG *)prl->operand;
+	return 0;
+}
+
+/* PapxFkp pages - paragraphs, tables and nesting */
+static void stat_papx(cfb_doc_t *doc, struct stat_row *r)
+{
+	struct PlcBtePapx *plcbtePapx = doc_plcbtePapx(doc);
+	if (!plcbtePapx)
+		return;
+
+	int i, j, runs = 0, inTable = 0, tables = 0, maxDepth = 0,
+			prev = 0;
+	int pages = doc->plcbtePapxNaFc - 1;
+	for (i = 0; i < pages; ++i) {
+		struct PapxFkp papxFkp;
+		BYTE buf[512];
+		memset(&papxFkp, 0, sizeof(papxFkp));
+		papxFkp_init(&papxFkp, buf, doc->WordDocument,
+				pnFkpPapx_pn(plcbtePapx->aPnBtePapx[i]) * 512);
+		runs += papxFkp.cpara;
+
+		for (j = 0; j < papxFkp.cpara; ++j) {
+			// PapxInFkp is at bOffset * 2 - 0 is default
+			// properties
+			int depth = 0;
+			int off = papxFkp.rgbx[j].bOffset * 2;
+			if (off > 0 && off < 510){
+				// size of GrpPrlAndIstd - see PapxInFkp
+				int size, start;
+				if (buf[off]){
+					size = 2 * buf[off] - 1;
+					start = off + 1;
+				} else {
+					size = 2 * buf[off + 1];
+					start = off + 2;
+				}
+				// grpprl is after istd
+				if (size > 2 && start + size <= 511)
+					parse_grpprl(&buf[start + 2], size - 2, &depth,
+							_papx_cb);
+			}
+			if (depth > 0){
+				inTable++;
+				if (prev == 0)
+					tables++;
+				if (depth > maxDepth)
+					maxDepth = depth;
+			}
+			prev = depth;
+		}
+	}
+	r->papx_pages = pages;
+	r->papx_runs = runs;
+	r->table_paragraphs = inTable;
+	r->tables = tables;
+	r->table_depth = maxDepth;
+}
+
+/* style sheet - number of styles and longest istdBase
+ * chain */
+static void stat_styles(cfb_doc_t *doc, struct stat_row *r)
+{
+	struct STSH *STSH = doc_stsh(doc);
+	if (!STSH)
+		return;
+
+	USHORT cstd = STSH->lpstshi->stshi->stshif.cstd;
+	int istd, maxDepth = 0;
+	for (istd = 0; istd < cstd; ++istd) {
+		int depth = 0;
+		USHORT i = istd;
+		// chain longer than cstd has a cycle
+		while (i != 0x0FFF && depth <= cstd) {
+			struct LPStd *LPStd = LPStd_at_index(STSH->rglpstd, cstd, i);
+			if (!LPStd || LPStd->cbStd == 0)
+				break;
+			depth++;
+			i = StdfBaseIstdBase((struct StdfBase *)LPStd->STD);
+		}
+		if (depth > maxDepth)
+			maxDepth = depth;
+	}
+	r->styles = cstd;
+	r->style_depth = maxDepth;
+}
+
+static void stat_file(const char *path, struct stat_row *r)
+{
+	int i;
+	double *v = (double *)r;
+	for (i = 0; i < NCOLUMNS; ++i)
+		v[i] = -1;
+
+	struct stat st;
+	if (stat(path, &st) == 0)
+		r->bytes = st.st_size;
+
+	int err;
+	cfb_doc_t *doc = doc_open(path, &err);
+	if (!doc)
+		return;
+	// count pieces as they are in file - not coalesced
+	doc_set_reference(doc, 1);
+
+	ldi_t info;
+	if (doc_get_info(doc, &info) == 0){
+		r->nFib = info.nFib;
+		r->fComplex = info.fComplex ? 1 : 0;
+		r->cQuickSaves = info.cQuickSaves;
+		r->ccpText = info.ccpText;
+	}
+
+	stat_pieces(doc, r);
+	stat_chpx(doc, r);
+	stat_papx(doc, r);
+	stat_styles(doc, r);
+
+	if (doc_plcfSed(doc))
+		r->sections = doc->plcfSedNaCP - 1;
+	// absent structures are 0, not unknown
+	FibRgFcLcb97 *rgFcLcb97 = (FibRgFcLcb97 *)doc->fib.rgFcLcb;
+	if (!rgFcLcb97->lcbPlcSpaMom)
+		r->floating_pictures = 0;
+	else if (doc_plcfspa(doc))
+		r->floating_pictures = doc->plcfspaNaCP - 1;
+	if (!rgFcLcb97->lcbDggInfo)
+		r->blips = 0;
+	else if (doc_dgginfo(doc))
+		r->blips = doc_dgginfo(doc)->nrgfb;
+
+	doc_close(doc);
+}
+
+static void *worker(void *arg)
+{
+	int i;
+	while ((i = __atomic_fetch_add(&files.next, 1,
+					__ATOMIC_RELAXED)) < files.n)
+		stat_file(files.path[i], &files.row[i]);
+	return NULL;
+}
+
+static void print_value(double v)
+{
+	if (v < 0)
+		return;
+	if (v == (long long)v)
+		printf("%lld", (long long)v);
+	else
+		printf("%.2f", v);
+}
+
+/* CSV string - quote if needed */
+static void print_string(const char *s)
+{
+	if (!strpbrk(s, ",\"\n")){
+		printf("%s", s);
+		return;
+	}
+	putchar('"');
+	for (; *s; ++s) {
+		if (*s == '"')
+			putchar('"');
+		putchar(*s);
+	}
+	putchar('"');
+}
+
+static void print_rows()
+{
+	int i, k;
+	printf("file");
+	for (k = 0; k < NCOLUMNS; ++k)
+		printf(",%s", column_names[k]);
+	printf("\n");
+
+	for (i = 0; i < files.n; ++i) {
+		print_string(files.path[i]);
+		double *v = (double *)&files.row[i];
+		for (k = 0; k < NCOLUMNS; ++k) {
+			putchar(',');
+			print_value(v[k]);
+		}
+		printf("\n");
+	}
+}
+
+static int double_compare(const void *a, const void *b)
+{
+	double x = *(double *)a, y = *(double *)b;
+	return x < y ? -1 : x > y;
+}
+
+/* distribution of each column over files where it is
+ * known */
+static void print_summary()
+{
+	double *a = malloc((files.n ? files.n : 1) * sizeof(double));
+	if (!a){
+		perror("malloc");
+		return;
+	}
+
+	printf("column,files,min,p50,p90,p99,max,mean\n");
+	int i, k;
+	for (k = 0; k < NCOLUMNS; ++k) {
+		int n = 0;
+		double sum = 0;
+		for (i = 0; i < files.n; ++i) {
+			double v = ((double *)&files.row[i])[k];
+			if (v < 0)
+				continue;
+			a[n++] = v;
+			sum += v;
+		}
+		printf("%s,%d", column_names[k], n);
+		if (n){
+			qsort(a, n, sizeof(double), double_compare);
+			double p[] = {0, 0.5, 0.9, 0.99, 1};
+			int j;
+			for (j = 0; j < 5; ++j) {
+				putchar(',');
+				print_value(a[(int)(p[j] * (n - 1) + 0.5)]);
+			}
+			printf(",%.2f", sum / n);
+		} else
+			printf(",,,,,,");
+		printf("\n");
+	}
+	free(a);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-j threads] [-s] dir\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int summary = 0, opt;
+	while ((opt = getopt(argc, argv, "j:sh")) != -1) {
+		switch (opt) {
+			case 'j': threads = atoi(optarg); break;
+			case 's': summary = 1; break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind != argc - 1){
+		usage(argv[0]);
+		return 1;
+	}
+	if (threads < 1)
+		threads = 1;
+
+	// broken files are counted, not logged
+	doc_set_log(DOC_LOG_NONE, NULL, NULL);
+
+	if (nftw(argv[optind], add_file, 16, FTW_PHYS)){
+		perror(argv[optind]);
+		return 1;
+	}
+	qsort(files.path, files.n, sizeof(char *), path_compare);
+	files.row = calloc(files.n ? files.n : 1, sizeof(struct stat_row));
+	if (!files.row){
+		perror("calloc");
+		return 1;
+	}
+
+	if (threads > files.n)
+		threads = files.n ? files.n : 1;
+	pthread_t *tid = malloc(threads * sizeof(pthread_t));
+	if (!tid){
+		perror("malloc");
+		return 1;
+	}
+	int i;
+	for (i = 0; i < threads; ++i)
+		if (pthread_create(&tid[i], NULL, worker, NULL)){
+			perror("pthread_create");
+			return 1;
+		}
+	for (i = 0; i < threads; ++i)
+		pthread_join(tid[i], NULL);
+	free(tid);
+
+	if (summary)
+		print_summary();
+	else
+		print_rows();
+
+	for (i = 0; i < files.n; ++i)
+		free(files.path[i]);
+	free(files.path);
+	free(files.row);
+	return 0;
+}
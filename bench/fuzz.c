@@ -0,0 +1,220 @@
+/**
+ * File              : fuzz.c
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+/* fuzz target for libFuzzer and AFL: parse arbitrary bytes
+ * as .doc - styles, text and pictures. Library reads files
+ * by name, so input is written to memfd and opened as
+ * /proc/self/fd/N.
+ *
+ * Besides crashes, input is slow when it takes more than
+ * DOC_FUZZ_NS_PER_BYTE nanoseconds (default 10000) or
+ * DOC_FUZZ_INSNS_PER_BYTE instructions (default 20000, if
+ * perf_event_open is allowed) per byte; inputs shorter
+ * than 4096 bytes count as 4096. Slow inputs are saved to
+ * DOC_FUZZ_SLOW_DIR (default "slow") as slow-<hash>. With
+ * DOC_FUZZ_ABORT_SLOW=1 slow input aborts, so fuzzer
+ * minimizes it as crash (libFuzzer -minimize_crash=1) for
+ * regression corpus. Work budget of library stops hangs.
+ *
+ * libFuzzer:
+ *   clang -fsanitize=fuzzer,address -DDOC_FUZZ_LIBFUZZER \
+ *     fuzz.c ../src/.libs/libdoc.a -o doc_fuzz
+ *   ./doc_fuzz -max_len=65536 corpus
+ * AFL (persistent mode) and replay of files:
+ *   afl-fuzz -i corpus -o out -- ./doc_fuzz
+ *   ./doc_fuzz file.doc ... */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bench.h"
+
+static struct {
+	int init;
+	int fd;             // memfd with input
+	char path[64];
+	int insns;          // instructions counter or -1
+	double nsPerByte;
+	double insnsPerByte;
+	const char *slowDir;
+	int abortSlow;
+} fuzz;
+
+static double env(const char *name, double def)
+{
+	const char *s = getenv(name);
+	return s ? atof(s) : def;
+}
+
+static void fuzz_init()
+{
+	fuzz.init = 1;
+	fuzz.fd = memfd_create("doc_fuzz", 0);
+	if (fuzz.fd < 0){
+		// no memfd - temporary file
+		char tmp[] = "/tmp/doc_fuzz.XXXXXX";
+		fuzz.fd = mkstemp(tmp);
+		if (fuzz.fd < 0){
+			perror("mkstemp");
+			abort();
+		}
+		unlink(tmp);
+	}
+	snprintf(fuzz.path, sizeof(fuzz.path),
+			"/proc/self/fd/%d", fuzz.fd);
+
+	fuzz.insns = insns_open();
+
+	fuzz.nsPerByte    = env("DOC_FUZZ_NS_PER_BYTE", 10000);
+	fuzz.insnsPerByte = env("DOC_FUZZ_INSNS_PER_BYTE", 20000);
+	fuzz.abortSlow    = env("DOC_FUZZ_ABORT_SLOW", 0);
+	fuzz.slowDir      = getenv("DOC_FUZZ_SLOW_DIR");
+	if (!fuzz.slowDir)
+		fuzz.slowDir = "slow";
+
+	doc_set_log(DOC_LOG_NONE, NULL, NULL);
+}
+
+/* FNV-1a - name of saved input */
+static uint64_t hash(const uint8_t *data, size_t size)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	size_t i;
+	for (i = 0; i < size; ++i) {
+		h ^= data[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static void save_slow(const uint8_t *data, size_t size,
+		double ns, long long insns)
+{
+	char path[BUFSIZ];
+	mkdir(fuzz.slowDir, 0755);
+	snprintf(path, sizeof(path), "%s/slow-%016llx",
+			fuzz.slowDir, (unsigned long long)hash(data, size));
+	FILE *fp = fopen(path, "wb");
+	if (fp){
+		fwrite(data, size, 1, fp);
+		fclose(fp);
+	}
+	fprintf(stderr, "doc_fuzz: slow input %s: %zu bytes, "
+			"%.0f ns/byte, %lld instructions/byte\n",
+			path, size, ns, insns);
+	if (fuzz.abortSlow)
+		abort();
+}
+
+static void parse(size_t size)
+{
+	int err;
+	libdoc_t *doc = doc_open(fuzz.path, &err);
+	if (!doc)
+		return;
+
+	// hangs and read blowups stop at budget and are slow
+	doc_set_budget(doc, 0, 10, 64 * size + (1 << 20));
+	doc_parse_styles(doc, NULL, styles_cb);
+	doc_parse_text(doc, 0, (unsigned long)-1, NULL, text_cb);
+	doc_extract_pictures(doc, NULL, picture_cb);
+	doc_close(doc);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	if (!fuzz.init)
+		fuzz_init();
+
+	if (ftruncate(fuzz.fd, 0) ||
+			pwrite(fuzz.fd, data, size, 0) != (ssize_t)size)
+	{
+		perror("pwrite");
+		abort();
+	}
+
+	long long insns = 0;
+	if (fuzz.insns >= 0)
+		counter_start(fuzz.insns);
+	double t = now();
+	parse(size);
+	t = now() - t;
+	if (fuzz.insns >= 0)
+		insns = counter_stop(fuzz.insns);
+
+	size_t n = size < 4096 ? 4096 : size;
+	double ns = t * 1e9 / n;
+	long long ipb = insns / n;
+	if (ns > fuzz.nsPerByte ||
+			(fuzz.insns >= 0 && ipb > fuzz.insnsPerByte))
+		save_slow(data, size, ns, ipb);
+
+	return 0;
+}
+
+#ifndef DOC_FUZZ_LIBFUZZER
+#ifndef __AFL_LOOP
+#define __AFL_LOOP(n) (!_once++)
+static int _once;
+#endif
+
+static int run_fd(int fd)
+{
+	uint8_t *data = NULL;
+	size_t size = 0, cap = 0;
+	ssize_t n;
+	do {
+		if (size == cap){
+			cap = cap ? cap * 2 : 65536;
+			data = realloc(data, cap);
+			if (!data){
+				perror("realloc");
+				return 1;
+			}
+		}
+		n = read(fd, data + size, cap - size);
+		if (n > 0)
+			size += n;
+	} while (n > 0);
+
+	LLVMFuzzerTestOneInput(data, size);
+	free(data);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	// replay files
+	if (argc > 1){
+		int i;
+		for (i = 1; i < argc; ++i) {
+			int fd = open(argv[i], O_RDONLY);
+			if (fd < 0){
+				perror(argv[i]);
+				return 1;
+			}
+			run_fd(fd);
+			close(fd);
+		}
+		return 0;
+	}
+
+	// AFL - input on stdin
+	while (__AFL_LOOP(1000)) {
+		lseek(0, 0, SEEK_SET);
+		run_fd(0);
+	}
+	return 0;
+}
+#endif /* ifndef DOC_FUZZ_LIBFUZZER */
@@ -0,0 +1,420 @@
+/**
+ * File              : microbench.c
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+/* run kernels of library on fixed in-memory inputs and
+ * print time of one operation as JSON line for each
+ * kernel:
+ *   doc_microbench [-t seconds] [-k kernel]
+ * Cycles are counted with perf_event_open when kernel
+ * allows it, otherwise cycles_per_op is null */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench.h"
+#include "../include/libdoc/doc.h"
+#include "../include/libdoc/prl.h"
+#include "../include/libdoc/sprm.h"
+#include "../include/libdoc/apply_properties.h"
+#include "../include/libdoc/style_properties.h"
+
+#define SPRM(ismpd, fSpec, sgc, spra) \
+	((ismpd) | (fSpec) << 9 | (sgc) << 10 | (spra) << 13)
+
+/* xorshift32 - inputs are the same on every run */
+static ULONG seed = 1;
+static ULONG _rand()
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+/* result of kernel - keeps compiler from removing work */
+static volatile ULONG sink;
+
+/* document for kernels with parser state */
+static cfb_doc_t doc;
+
+/* grpprl with sprms of paragraph, character, section and
+ * table properties */
+static BYTE grpprl[256];
+static int grpprlLen;
+
+static void put_sprm(USHORT sprm, ULONG operand, int bytes)
+{
+	grpprl[grpprlLen++] = sprm;
+	grpprl[grpprlLen++] = sprm >> 8;
+	while (bytes--) {
+		grpprl[grpprlLen++] = operand;
+		operand >>= 8;
+	}
+}
+
+static void setup_grpprl()
+{
+	grpprlLen = 0;
+	put_sprm(SPRM(sprmPJc80,       0, sgcPar, 1), 1, 1);
+	put_sprm(SPRM(sprmPFInTable,   0, sgcPar, 1), 1, 1);
+	put_sprm(SPRM(sprmPItap,       1, sgcPar, 3), 1, 4);
+	put_sprm(SPRM(sprmPDyaBefore,  0, sgcPar, 5), 120, 2);
+	put_sprm(SPRM(sprmPDyaAfter,   0, sgcPar, 5), 240, 2);
+	put_sprm(SPRM(sprmCFBold,      0, sgcCha, 0), 1, 1);
+	put_sprm(SPRM(sprmCFItalic,    0, sgcCha, 0), 0, 1);
+	put_sprm(SPRM(sprmCHps,        1, sgcCha, 2), 24, 2);
+	put_sprm(SPRM(sprmCIco,        1, sgcCha, 1), 6, 1);
+	put_sprm(SPRM(sprmCHighlight,  1, sgcCha, 1), 7, 1);
+	put_sprm(SPRM(sprmSCcolumns,   0, sgcSec, 2), 1, 2);
+	put_sprm(SPRM(sprmCFBold,      0, sgcCha, 0), 0x81, 1);
+}
+
+/* parse_grpprl - one grpprl */
+static int grpprl_cb(void *userdata, struct Prl *prl)
+{
+	sink += prl->sprm;
+	return 0;
+}
+
+static void run_grpprl()
+{
+	parse_grpprl(grpprl, grpprlLen, NULL, grpprl_cb);
+}
+
+/* apply_property - one Prl of grpprl */
+static struct Prl *prls[32];
+static int nprls;
+
+static int prls_cb(void *userdata, struct Prl *prl)
+{
+	prls[nprls++] = prl;
+	return 0;
+}
+
+static void setup_apply()
+{
+	setup_grpprl();
+	nprls = 0;
+	parse_grpprl(grpprl, grpprlLen, NULL, prls_cb);
+}
+
+static void run_apply()
+{
+	static int i;
+	apply_property(&doc, i % 2, prls[i % nprls]);
+	i++;
+}
+
+/* PLC search - aFc of fast-saved document */
+#define PLC_N    1024
+#define PLC_KEYS 4096
+static ULONG plc[PLC_N];
+static ULONG plcKeys[PLC_KEYS];
+
+static void setup_plc()
+{
+	int i;
+	plc[0] = 0x400;
+	for (i = 1; i < PLC_N; ++i)
+		plc[i] = plc[i-1] + 1 + _rand() % 512;
+	for (i = 0; i < PLC_KEYS; ++i)
+		plcKeys[i] = plc[0] + _rand() % (plc[PLC_N-1] - plc[0]);
+}
+
+static void run_plc()
+{
+	static int i;
+	sink += plc_search(plc, PLC_N, plcKeys[i++ % PLC_KEYS]);
+}
+
+/* ChpxFkp and PapxFkp - find run of fc as text parsing
+ * does: page from cache of doc_fkp_page (read again when
+ * page changes), decoded in place and searched for fc */
+#define FKP_PAGES 2
+#define FKP_RUN   64     // lookups in page before next page
+#define FKP_KEYS  4096
+static BYTE stream[512 * (FKP_PAGES + 1)];
+static ULONG fkpKeys[FKP_KEYS];
+static FILE *fp;
+
+static void setup_fkp(int papx)
+{
+	int i, k, n = papx ? 0x1D : 0x65;
+	memset(stream, 0, sizeof(stream));
+	for (k = 1; k <= FKP_PAGES; ++k) {
+		BYTE *p = stream + 512 * k;
+		for (i = 0; i <= n; ++i) {
+			ULONG fc = 0x400 + 40 * i;
+			memcpy(&p[4 * i], &fc, 4);
+		}
+		if (papx){
+			// PapxInFkp with istd and sprmPJc80
+			p[480] = 0; p[481] = 3;
+			p[482] = 1; p[483] = 0;
+			p[484] = 0x03; p[485] = 0x24; p[486] = 1;
+			for (i = 0; i < n; ++i)
+				p[4 * (n + 1) + 13 * i] = 240;
+		} else {
+			// Chpx with sprmCFBold for every other run
+			p[500] = 3;
+			p[501] = 0x35; p[502] = 0x08; p[503] = 1;
+			for (i = 0; i < n; ++i)
+				p[4 * (n + 1) + i] = i % 2 ? 250 : 0;
+		}
+		p[511] = n;
+	}
+	for (i = 0; i < FKP_KEYS; ++i)
+		fkpKeys[i] = 0x400 + _rand() % (40 * n);
+
+	if (!fp)
+		fp = fmemopen(stream, sizeof(stream), "rb");
+	doc.WordDocument = fp;
+	doc.chpxCache.valid = 0;
+	doc.papxCache.valid = 0;
+}
+
+static void setup_chpx()
+{
+	setup_fkp(0);
+}
+
+static void setup_papx()
+{
+	setup_fkp(1);
+}
+
+static void run_chpx()
+{
+	static int i;
+	ULONG of = 512 * (1 + i / FKP_RUN % FKP_PAGES);
+	ULONG fc = fkpKeys[i++ % FKP_KEYS];
+	BYTE *buf = doc_fkp_page(&doc, &doc.chpxCache, of);
+	struct ChpxFkp fkp;
+	chpxFkp_set(&fkp, buf);
+	int j;
+	for (j = 0; j < fkp.crun && fkp.rgfc[j] <= fc;)
+		j++;
+	j--;
+	if (fkp.rgb[j])
+		sink += buf[fkp.rgb[j] * 2];
+}
+
+static void run_papx()
+{
+	static int i;
+	ULONG of = 512 * (1 + i / FKP_RUN % FKP_PAGES);
+	ULONG fc = fkpKeys[i++ % FKP_KEYS];
+	BYTE *buf = doc_fkp_page(&doc, &doc.papxCache, of);
+	struct PapxFkp fkp;
+	papxFkp_set(&fkp, buf);
+	int k;
+	for (k = 0; k < fkp.cpara && fkp.rgfc[k] <= fc;)
+		k++;
+	k--;
+	sink += buf[fkp.rgbx[k].bOffset * 2];
+}
+
+/* apply_style_properties - STSH with chains of 8 styles */
+#define STYLES 64
+#define STYLE_DEPTH 8
+static BYTE stsh[STYLES * 64 + 32];
+
+static int stsh_u16(int off, USHORT v)
+{
+	stsh[off] = v;
+	stsh[off + 1] = v >> 8;
+	return off + 2;
+}
+
+static void setup_styles()
+{
+	int istd, off = 0;
+	memset(stsh, 0, sizeof(stsh));
+	off = stsh_u16(off, 20);                // cbStshi
+	off = stsh_u16(off, STYLES);            // cstd
+	off = stsh_u16(off, 0x000A);            // cbSTDBaseInFile
+	off += 16;
+
+	for (istd = 0; istd < STYLES; ++istd) {
+		int lp = off, i;
+		USHORT base = istd % STYLE_DEPTH ? istd - 1 : 0x0FFF;
+		off += 2;
+		off = stsh_u16(off, istd ? 0x0FFE : 0);  // sti
+		off = stsh_u16(off, 1 | base << 4);      // stkPar
+		off = stsh_u16(off, 2);                  // cupx
+		off += 4;
+		off = stsh_u16(off, 1);                  // xstzName
+		off = stsh_u16(off, 'A' + istd % 26);
+		off = stsh_u16(off, 0);
+		off = stsh_u16(off, 5);                  // LPUpxPapx
+		off = stsh_u16(off, istd);
+		off = stsh_u16(off, SPRM(sprmPJc80, 0, sgcPar, 1));
+		stsh[off++] = istd % 3;
+		off++;
+		off = stsh_u16(off, 4);                  // LPUpxChpx
+		off = stsh_u16(off, SPRM(sprmCHps, 1, sgcCha, 2));
+		off = stsh_u16(off, 20 + 2 * (istd % STYLE_DEPTH));
+		for (i = 0; i < 2; ++i)
+			stsh[lp + i] = (off - lp - 2) >> (8 * i);
+	}
+
+	doc.STSH.lpstshi = (struct LPStshi *)stsh;
+	doc.STSH.rglpstd = &stsh[20 + 2];
+	doc.loaded |= DOC_LOAD_STSH;
+
+	// index of LPStd as _doc_STSH_init builds it
+	free(doc.aLPStd);
+	doc_lpstd_index(&doc, off - (20 + 2));
+}
+
+static void run_styles()
+{
+	static int i;
+	// last style of each chain
+	USHORT istd = (i++ * STYLE_DEPTH + STYLE_DEPTH - 1) % STYLES;
+	sink += apply_style_properties(&doc, istd) != NULL;
+}
+
+/* _utf16_to_utf8 - one character as in get_char_for_cp */
+#define UTF16_N 1024
+static uint16_t utf16[UTF16_N];
+
+static void setup_utf16()
+{
+	int i;
+	for (i = 0; i < UTF16_N; ++i) {
+		switch (_rand() % 4) {
+			case 0:  utf16[i] = 0x0430 + _rand() % 32; break;
+			case 1:  utf16[i] = 0x4E00 + _rand() % 0x100; break;
+			default: utf16[i] = 'a' + _rand() % 26; break;
+		}
+	}
+}
+
+static void run_utf16()
+{
+	static int i;
+	char utf8[4] = {0};
+	_utf16_to_utf8(&utf16[i++ % UTF16_N], 1, utf8);
+	sink += utf8[0];
+}
+
+static struct kernel {
+	const char *name;
+	void (*setup)();
+	void (*run)();
+} kernels[] = {
+	{"parse_grpprl",          setup_grpprl, run_grpprl},
+	{"plc_search",            setup_plc,    run_plc},
+	{"chpxFkp_lookup",        setup_chpx,   run_chpx},
+	{"papxFkp_lookup",        setup_papx,   run_papx},
+	{"apply_property",        setup_apply,  run_apply},
+	{"apply_style_properties",setup_styles, run_styles},
+	{"utf16_to_utf8",         setup_utf16,  run_utf16},
+	{NULL, NULL, NULL}
+};
+
+static void bench(struct kernel *k, double seconds, int cycles)
+{
+	k->setup();
+
+	// grow batch until it takes 1/10 of time
+	unsigned long i, n = 1;
+	double t;
+	for (;;) {
+		t = now();
+		for (i = 0; i < n; ++i)
+			k->run();
+		t = now() - t;
+		if (t > seconds / 10 || n > (1UL << 40))
+			break;
+		n *= 2;
+	}
+
+	unsigned long ops = 0;
+	double elapsed = 0;
+	long long c = 0;
+	if (cycles >= 0)
+		counter_start(cycles);
+	while (elapsed < seconds) {
+		t = now();
+		for (i = 0; i < n; ++i)
+			k->run();
+		elapsed += now() - t;
+		ops += n;
+	}
+	if (cycles >= 0)
+		c = counter_stop(cycles);
+
+	printf("{\"kernel\":\"%s\",\"ops\":%lu,\"seconds\":%.3f,"
+			"\"ns_per_op\":%.2f,",
+			k->name, ops, elapsed, elapsed * 1e9 / ops);
+	if (c > 0)
+		printf("\"cycles_per_op\":%.2f}\n", (double)c / ops);
+	else
+		printf("\"cycles_per_op\":null}\n");
+	fflush(stdout);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+			"Usage: %s [-t seconds] [-k kernel]\n"
+			"kernels:", prog);
+	struct kernel *k;
+	for (k = kernels; k->name; ++k)
+		fprintf(stderr, " %s", k->name);
+	fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[])
+{
+	double seconds = 1;
+	const char *only = NULL;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "t:k:h")) != -1) {
+		switch (opt) {
+			case 't': seconds = atof(optarg); break;
+			case 'k': only = optarg;          break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind != argc || seconds <= 0){
+		usage(argv[0]);
+		return 1;
+	}
+
+	// messages of malformed input are not part of kernels
+	doc_set_log(DOC_LOG_NONE, NULL, NULL);
+
+	int cycles = counter_open(PERF_COUNT_HW_CPU_CYCLES);
+	int found = 0;
+	struct kernel *k;
+	for (k = kernels; k->name; ++k) {
+		if (only && strcmp(only, k->name))
+			continue;
+		bench(k, seconds, cycles);
+		found = 1;
+	}
+
+	if (cycles >= 0)
+		close(cycles);
+	if (fp)
+		fclose(fp);
+	free(doc.aLPStd);
+
+	if (!found){
+		usage(argv[0]);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,265 @@
+/**
+ * File              : perfcheck.c
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+/* performance regression gate: measure each mode (parse,
+ * text, styles, pictures) on each .doc file of corpus and
+ * compare with baseline JSON file:
+ *   doc_perfcheck [-b baseline] [-p percent] [-u] dir
+ * Instructions are counted with perf_event_open - they are
+ * stable on shared machines. If kernel does not allow it,
+ * the gate is skipped: time is too noisy for percent 
+ * threshold. Return 1 if baseline is missing or any metric
+ * grows more than percent (default 2). With -u baseline is
+ * written instead of compared */
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define REPS 3
+#define NAME_LEN 256
+
+/* metric of mode on file */
+struct metric {
+	char name[NAME_LEN];  // mode/file
+	double value;
+	double baseline;      // -1 if not in baseline
+};
+
+struct metrics {
+	struct metric *m;
+	int n, cap;
+};
+
+static struct metric *metrics_add(struct metrics *ms,
+		const char *name)
+{
+	if (ms->n == ms->cap){
+		ms->cap = ms->cap ? ms->cap * 2 : 64;
+		ms->m = realloc(ms->m, ms->cap * sizeof(struct metric));
+		if (!ms->m){
+			perror("realloc");
+			exit(ENOMEM);
+		}
+	}
+	struct metric *m = &ms->m[ms->n++];
+	memset(m, 0, sizeof(struct metric));
+	snprintf(m->name, sizeof(m->name), "%s", name);
+	m->baseline = -1;
+	return m;
+}
+
+static struct metric *metrics_find(struct metrics *ms,
+		const char *name)
+{
+	int i;
+	for (i = 0; i < ms->n; ++i)
+		if (!strcmp(ms->m[i].name, name))
+			return &ms->m[i];
+	return NULL;
+}
+
+/* best of REPS runs in instructions */
+static double measure(struct mode *m, const char *path,
+		int insns)
+{
+	double best = -1;
+	int r;
+	// warm up file cache
+	m->run(path);
+	for (r = 0; r < REPS; ++r) {
+		counter_start(insns);
+		m->run(path);
+		double v = counter_stop(insns);
+		if (best < 0 || v < best)
+			best = v;
+	}
+	return best;
+}
+
+static int measure_corpus(struct metrics *ms, const char *dir,
+		int insns)
+{
+	struct dirent **e;
+	int n = scandir(dir, &e, NULL, alphasort);
+	if (n < 0){
+		perror(dir);
+		return -1;
+	}
+
+	int i;
+	for (i = 0; i < n; ++i) {
+		size_t len = strlen(e[i]->d_name);
+		if (len >= 4 && !strcasecmp(e[i]->d_name + len - 4, ".doc")){
+			char path[BUFSIZ];
+			snprintf(path, sizeof(path), "%s/%s", dir, e[i]->d_name);
+			struct mode *m;
+			for (m = modes; m->name; ++m) {
+				char name[NAME_LEN];
+				if (snprintf(name, sizeof(name), "%s/%s",
+						m->name, e[i]->d_name) >= (int)sizeof(name))
+				{
+					fprintf(stderr, "%s: name is too long - skipped\n",
+							e[i]->d_name);
+					break;
+				}
+				metrics_add(ms, name)->value = measure(m, path, insns);
+			}
+		}
+		free(e[i]);
+	}
+	free(e);
+	return 0;
+}
+
+/* baseline file is JSON object with metric unit and
+ * results - one "mode/file": value per line, as it is
+ * written by baseline_write */
+static int baseline_read(struct metrics *ms, const char *path,
+		const char *unit)
+{
+	FILE *fp = fopen(path, "r");
+	if (!fp){
+		perror(path);
+		return -1;
+	}
+
+	char line[BUFSIZ], name[BUFSIZ], u[64] = "";
+	double v;
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, " \"unit\": \"%63[^\"]\"", u) == 1)
+			continue;
+		if (sscanf(line, " \"%[^\"]\": %lf", name, &v) != 2)
+			continue;
+		struct metric *m = metrics_find(ms, name);
+		if (m)
+			m->baseline = v;
+	}
+	fclose(fp);
+
+	if (strcmp(u, unit)){
+		fprintf(stderr, "%s: baseline is in %s, measured in %s - "
+				"update baseline\n", path, u[0] ? u : "unknown", unit);
+		return -1;
+	}
+	return 0;
+}
+
+static int baseline_write(struct metrics *ms, const char *path,
+		const char *unit)
+{
+	FILE *fp = fopen(path, "w");
+	if (!fp){
+		perror(path);
+		return -1;
+	}
+	fprintf(fp, "{\n  \"unit\": \"%s\",\n  \"results\": {\n", unit);
+	int i;
+	for (i = 0; i < ms->n; ++i)
+		fprintf(fp, "    \"%s\": %.0f%s\n", ms->m[i].name,
+				ms->m[i].value, i < ms->n - 1 ? "," : "");
+	fprintf(fp, "  }\n}\n");
+	fclose(fp);
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+			"Usage: %s [-b baseline] [-p percent] [-u] dir\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *baseline = "perf-baseline.json";
+	double percent = 2;
+	int update = 0, opt;
+	while ((opt = getopt(argc, argv, "b:p:uh")) != -1) {
+		switch (opt) {
+			case 'b': baseline = optarg; break;
+			case 'p': percent = atof(optarg); break;
+			case 'u': update = 1; break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind != argc - 1 || percent < 0){
+		usage(argv[0]);
+		return 1;
+	}
+
+	doc_set_log(DOC_LOG_NONE, NULL, NULL);
+
+	const char *unit = "instructions";
+	int insns = insns_open();
+	if (insns < 0){
+		fprintf(stderr, "no instruction counter - "
+				"perfcheck skipped\n");
+		// baseline can not be written without counter
+		return update ? 1 : 0;
+	}
+	if (!update && access(baseline, R_OK)){
+		fprintf(stderr, "no baseline %s - write it with -u "
+				"(make perfcheck-update)\n", baseline);
+		return 1;
+	}
+
+	struct metrics ms;
+	memset(&ms, 0, sizeof(ms));
+	if (measure_corpus(&ms, argv[optind], insns))
+		return 1;
+	close(insns);
+	if (ms.n == 0){
+		fprintf(stderr, "no .doc files in %s\n", argv[optind]);
+		return 1;
+	}
+
+	if (update){
+		if (baseline_write(&ms, baseline, unit))
+			return 1;
+		fprintf(stderr, "%s: %d metrics in %s\n",
+				baseline, ms.n, unit);
+		free(ms.m);
+		return 0;
+	}
+
+	if (baseline_read(&ms, baseline, unit))
+		return 1;
+
+	int i, failed = 0;
+	for (i = 0; i < ms.n; ++i) {
+		struct metric *m = &ms.m[i];
+		if (m->baseline < 0){
+			printf("{\"metric\":\"%s\",\"unit\":\"%s\",\"value\":%.0f,"
+					"\"baseline\":null,\"ok\":true}\n",
+					m->name, unit, m->value);
+			continue;
+		}
+		double change = m->baseline > 0 ?
+			(m->value - m->baseline) * 100 / m->baseline : 0;
+		int ok = change <= percent;
+		if (!ok)
+			failed++;
+		printf("{\"metric\":\"%s\",\"unit\":\"%s\",\"value\":%.0f,"
+				"\"baseline\":%.0f,\"change_pct\":%.2f,\"ok\":%s}\n",
+				m->name, unit, m->value, m->baseline, change,
+				ok ? "true" : "false");
+	}
+	if (failed)
+		fprintf(stderr, "%d of %d metrics regressed more than "
+				"%.1f%%\n", failed, ms.n, percent);
+
+	free(ms.m);
+	return failed ? 1 : 0;
+}
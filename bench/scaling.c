@@ -0,0 +1,198 @@
+/**
+ * File              : scaling.c
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+/* grow synthetic documents along one axis (pieces,
+ * paragraphs, table cells, styles, inline and floating 
+ * pictures) to sizes N, 2N, 4N and 8N, parse each with 
+ * doc_parse (pictures are located, not read) and fit
+ * exponent of time = c * size^k. Print JSON line for each
+ * axis and fail if k is above threshold:
+ *   doc_scaling [-g doc_gen] [-a axis] [-t threshold]
+ *               [-n scale]
+ * Other properties of document are kept proportional to
+ * the axis, so linear parser has k near 1 */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench.h"
+
+#define SIZES 4
+
+/* locate pictures as doc2txt does */
+static int locate_cb(void *d, DOC_PART part, ldp_t *p, int ch){
+	if (ch == INLINE_PICTURE || ch == FLOATING_PICTURE){
+		ldb_t blip;
+		doc_get_picture_view(ch, p, &blip);
+	}
+	return 0;
+}
+
+/* axes - options of doc_gen for size n */
+static struct axis {
+	const char *name;
+	int n;             // N for scale 1
+	const char *fmt;   // doc_gen options, %d is size
+} axes[] = {
+	{"paragraphs", 500,
+		"--paragraphs %d --paragraph-length 100"},
+	{"pieces",     250,
+		"--paragraphs %d --paragraph-length 100 --pieces %d"},
+	{"cells",      50,
+		"--paragraphs 2 --tables 1 --rows %d --columns 8"},
+	{"styles",     100,
+		"--paragraphs %d --paragraph-length 20 --styles %d "
+		"--style-depth 4"},
+	{"pictures",   100,
+		"--paragraphs %d --paragraph-length 20 --pictures %d "
+		"--picture-size 256"},
+	{"shapes",     100,
+		"--paragraphs %d --paragraph-length 20 --shapes %d "
+		"--picture-size 256"},
+	{NULL, 0, NULL}
+};
+
+/* best time of doc_parse - repeat short runs to get above
+ * clock resolution */
+static double parse_time(const char *path)
+{
+	double best = 0;
+	int i, reps = 1;
+	for (i = 0; i < 3; ++i) {
+		double t = now();
+		int k;
+		for (k = 0; k < reps; ++k)
+			doc_parse(path, NULL, styles_cb, locate_cb);
+		t = (now() - t) / reps;
+		if (i == 0 && t < 0.05)
+			reps = 0.05 / (t + 1e-9) + 1;
+		if (i == 0 || t < best)
+			best = t;
+	}
+	return best;
+}
+
+/* least squares slope of log(t) over log(n) */
+static double exponent(const double *n, const double *t)
+{
+	double sx = 0, sy = 0, sxx = 0, sxy = 0;
+	int i;
+	for (i = 0; i < SIZES; ++i) {
+		double x = log(n[i]), y = log(t[i]);
+		sx += x; sy += y; sxx += x * x; sxy += x * y;
+	}
+	return (SIZES * sxy - sx * sy) / (SIZES * sxx - sx * sx);
+}
+
+static int run_axis(struct axis *a, const char *gen,
+		const char *dir, double scale, double threshold)
+{
+	double n[SIZES], t[SIZES];
+	int i;
+	for (i = 0; i < SIZES; ++i) {
+		int size = a->n * scale * (1 << i);
+		if (size < 1)
+			size = 1;
+
+		char opts[BUFSIZ], path[BUFSIZ], cmd[BUFSIZ * 3];
+		snprintf(opts, sizeof(opts), a->fmt, size, size);
+		snprintf(path, sizeof(path), "%s/%s-%d.doc",
+				dir, a->name, size);
+		if (snprintf(cmd, sizeof(cmd), "%s %s -o %s", 
+					gen, opts, path) >= (int)sizeof(cmd))
+		{
+			fprintf(stderr, "%s: path is too long\n", gen);
+			return -1;
+		}
+		if (system(cmd)){
+			fprintf(stderr, "%s: failed\n", cmd);
+			return -1;
+		}
+
+		n[i] = size;
+		t[i] = parse_time(path);
+		unlink(path);
+	}
+
+	double k = exponent(n, t);
+	int ok = k <= threshold;
+	printf("{\"axis\":\"%s\",\"sizes\":[", a->name);
+	for (i = 0; i < SIZES; ++i)
+		printf("%s%.0f", i ? "," : "", n[i]);
+	printf("],\"seconds\":[");
+	for (i = 0; i < SIZES; ++i)
+		printf("%s%.6f", i ? "," : "", t[i]);
+	printf("],\"exponent\":%.2f,\"threshold\":%.2f,\"ok\":%s}\n",
+			k, threshold, ok ? "true" : "false");
+	fflush(stdout);
+	return ok ? 0 : 1;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+			"Usage: %s [-g doc_gen] [-a axis] [-t threshold] "
+			"[-n scale]\naxes:", prog);
+	struct axis *a;
+	for (a = axes; a->name; ++a)
+		fprintf(stderr, " %s", a->name);
+	fprintf(stderr, "\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *gen = "./doc_gen";
+	const char *only = NULL;
+	double threshold = 1.3, scale = 1;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "g:a:t:n:h")) != -1) {
+		switch (opt) {
+			case 'g': gen = optarg;              break;
+			case 'a': only = optarg;             break;
+			case 't': threshold = atof(optarg);  break;
+			case 'n': scale = atof(optarg);      break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (optind != argc || scale <= 0){
+		usage(argv[0]);
+		return 1;
+	}
+
+	// messages of generated documents are not measured
+	doc_set_log(DOC_LOG_ERR, NULL, NULL);
+
+	char dir[] = "/tmp/doc_scaling.XXXXXX";
+	if (!mkdtemp(dir)){
+		perror("mkdtemp");
+		return 1;
+	}
+
+	int ret = 0, found = 0;
+	struct axis *a;
+	for (a = axes; a->name; ++a) {
+		if (only && strcmp(only, a->name))
+			continue;
+		found = 1;
+		int r = run_axis(a, gen, dir, scale, threshold);
+		if (r)
+			ret = 1;
+	}
+	rmdir(dir);
+
+	if (!found){
+		usage(argv[0]);
+		return 1;
+	}
+	return ret;
+}
@@ -2,7 +2,7 @@
  * File              : libdoc.h
  * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
  * Date              : 27.05.2024
- * Last Modified Date: 06.08.2024
+ * Last Modified Date: 18.10.2026
  * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
  */
 
@@ -79,6 +79,34 @@ typedef struct libdoc_prop {
 	void *data;
 } ldp_t;
 
+/*
+ * Error codes
+ */
+enum {
+	DOC_NO_ERR,     //no error
+	DOC_CB_STOP,    //stopped by callback
+	DOC_ERR_FILE,   //error to read file
+	DOC_ERR_HEADER, //error to read header
+	DOC_ERR_ALLOC,  //memory allocation error
+	DOC_ERR_BUDGET, //work budget is exceeded
+	DOC_CANCEL,     //canceled with doc_cancel
+};
+
+/*
+ * Log levels
+ */
+enum {
+	DOC_LOG_NONE,   //no messages
+	DOC_LOG_ERR,    //errors (default)
+	DOC_LOG_DEBUG,  //debug messages (library built with 
+	                //DEBUG)
+};
+
+/* number of messages from one place in code that are passed 
+ * to log sink - after that only messages with number that 
+ * is power of 2 are passed */
+#define DOC_LOG_BURST 8
+
 typedef enum {
 	MAIN_DOCUMENT,
 	FOOTNOTES,
@@ -90,16 +118,275 @@ typedef enum {
 
 } DOC_PART;
 
+/* opaque MS-DOC document handle */
+typedef struct cfb_doc libdoc_t;
+
+/* document information from File Information Block */
+typedef struct libdoc_info {
+	int  nFib;          // file format version
+	int  lid;           // install language of application
+	char fDot;          // document is a template
+	char fComplex;      // document is fast-saved
+	char fHasPic;       // document contains pictures
+	char fEncrypted;    // document is encrypted
+	char fFarEast;      // installation language is East Asian
+	int  cQuickSaves;   // number of consecutive fast-saves
+	long ccpText;       // number of CP in main document
+	long ccpFtn;        // number of CP in footnotes
+	long ccpHdd;        // number of CP in headers
+	long ccpAtn;        // number of CP in comments
+	long ccpEdn;        // number of CP in endnotes
+	long ccpTxbx;       // number of CP in textboxes
+	long ccpHdrTxbx;    // number of CP in header textboxes
+	int  nSections;     // number of sections
+} ldi_t;
+
+/* document parsing statistics */
+typedef struct libdoc_stats {
+	unsigned long chars;        // characters passed to text 
+	                            // callback
+	unsigned long pieces;       // lookups in PlcPcd
+	unsigned long fkpReads;     // FKP pages read from stream
+	unsigned long fkpHits;      // FKP pages found in cache
+	unsigned long sprms;        // sprms applied
+	unsigned long sprmsUnknown; // sprms of unknown group
+	                            // skipped
+	unsigned long styles;       // styles resolved
+	unsigned long bytes;        // bytes read from streams
+	                            // while parsing text
+	unsigned long seeks;        // seeks while parsing text
+	double tRead;               // seconds to read FIB
+	double tStyles;             // seconds to parse styles
+	double tParts[7];           // seconds to parse each
+	                            // DOC_PART
+} lds_t;
+
 /* open MS-DOC file and run callbacks for characters in 
- * main document, footnotes and headers */
+ * main document, footnotes and headers - parsing stops if
+ * callback returns non-zero and DOC_CB_STOP is returned */
 int doc_parse(const char *filename, void *user_data,
 		int (*styles)(void *user_data, STYLE *s),
 		int (*text)(void *user_data, DOC_PART part, ldp_t *p, int ch));
 
+/* open MS-DOC file and return document handle to run 
+ * several operations on it - only FIB is read here, other
+ * structures are loaded on first use. Return NULL on error
+ * and set err (if not NULL) to error code */
+libdoc_t *doc_open(const char *filename, int *err);
+
+/* free memory and close document */
+void doc_close(libdoc_t *doc);
+
+/* limit doc_parse_text to first max_chars CP of range, 
+ * e.g. to get text preview (0 - no limit) */
+void doc_set_max_chars(libdoc_t *doc, unsigned long max_chars);
+
+/* parse with reference algorithm of specification (non-zero
+ * reference): structures are looked up for each CP, caches
+ * are not used and piece table is not coalesced - slow, to
+ * test fast paths against. Call before parsing */
+void doc_set_reference(libdoc_t *doc, int reference);
+
+/* pass characters to text callback without style 
+ * properties (non-zero text_only): style sheet is not read
+ * by doc_parse_text and ldp_t has direct formatting only. 
+ * doc_parse_styles still reads style sheet */
+void doc_set_text_only(libdoc_t *doc, int text_only);
+
+/* limit work for document to protect from malformed files:
+ * iterations of parsing loops, seconds of CPU time and 
+ * bytes read from streams (0 - no limit). Limits are 
+ * counted from start of each call of doc_parse_text, 
+ * doc_parse_styles and doc_extract_pictures - the call 
+ * stops and returns DOC_ERR_BUDGET when any limit is 
+ * exceeded */
+void doc_set_budget(libdoc_t *doc, unsigned long max_iterations,
+		double max_seconds, unsigned long max_bytes);
+
+/* set callback to report progress of doc_parse_text after
+ * each paragraph: cp is number of parsed CP, total is 
+ * number of CP in range. Parsing is canceled if callback 
+ * returns non-zero */
+void doc_set_progress(libdoc_t *doc, void *userdata,
+		int (*progress)(void *userdata, 
+			unsigned long cp, unsigned long total));
+
+/* get number of CP parsed by doc_parse_text and set total
+ * (if not NULL) to number of CP in range - can be called 
+ * from other thread */
+unsigned long doc_get_progress(libdoc_t *doc, 
+		unsigned long *total);
+
+/* cancel parsing of document - doc_parse_text stops at next
+ * paragraph (doc_extract_pictures at next picture) and 
+ * returns DOC_CANCEL. Cancel is cleared when DOC_CANCEL is 
+ * returned, so document can be parsed again. Can be called
+ * from other thread or signal handler */
+void doc_cancel(libdoc_t *doc);
+
+/* fill stats with counters of document, or with counters 
+ * of document last closed by this thread (e.g. by 
+ * doc_parse) if doc is NULL */
+void doc_get_stats(libdoc_t *doc, lds_t *stats);
+
+/* fill document information - return non-zero on error */
+int doc_get_info(libdoc_t *doc, ldi_t *info);
+
+/* run callback for each style in document style sheet - 
+ * return DOC_CB_STOP if callback returns non-zero */
+int doc_parse_styles(libdoc_t *doc, void *user_data,
+		int (*styles)(void *user_data, STYLE *s));
+
+/* run callback for characters of main document from CP 
+ * first to CP last (not included) - return DOC_CB_STOP if
+ * callback returns non-zero */
+int doc_parse_text(libdoc_t *doc, 
+		unsigned long first, unsigned long last,
+		void *user_data,
+		int (*text)(void *user_data, DOC_PART part, ldp_t *p, int ch));
+
+/* get picture for INLINE_PICTURE or FLOATING_PICTURE 
+ * character from text callback - picture data is read to 
+ * memory and valid only while callback runs */
 void doc_get_picture(
 		int ch, ldp_t *p, void *userdata,
 		void (*callback)(struct picture *pic, void *userdata));
 
+/* location of picture data (BLIPFileData) in document 
+ * stream - data is not read: it can be read directly from 
+ * stream (or fileno(stream)) at offset. Stream is owned by
+ * document and valid until doc_close */
+typedef struct libdoc_blip {
+	PICT  pic;              // picture type, size and len
+	                        // (pic.data is NULL)
+	unsigned char uid[16];  // MD4 digest of picture data
+	FILE *stream;           // document stream with data
+	long  offset;           // offset of data in stream
+	char  compressed;       // metafile data is DEFLATE
+	                        // compressed
+	unsigned long cbSize;   // uncompressed size of metafile
+} ldb_t;
+
+/* default size of chunk for doc_get_picture_stream */
+#define DOC_PICTURE_CHUNK 65536
+
+/* get location of picture data for INLINE_PICTURE or
+ * FLOATING_PICTURE character without reading it - return
+ * non-zero on error */
+int doc_get_picture_view(int ch, ldp_t *p, ldb_t *blip);
+
+/* get picture metadata for INLINE_PICTURE or 
+ * FLOATING_PICTURE character: same as doc_get_picture_view
+ * and pic.w and pic.h - bitmap size in pixels (from PNG, 
+ * JPEG or DIB header), EMF header bounds, WMF placeable
+ * header bounds at 96 DPI or OfficeArtMetafileHeader 
+ * bounds. Only headers are read (compressed metafile is
+ * inflated up to header) - return non-zero on error */
+int doc_get_picture_info(int ch, ldp_t *p, ldb_t *blip);
+
+/* read picture data for INLINE_PICTURE or FLOATING_PICTURE
+ * character by chunks of chunk bytes (DOC_PICTURE_CHUNK if
+ * 0) and run sink for each - return DOC_CB_STOP if sink
+ * returns non-zero, or other error code */
+int doc_get_picture_stream(
+		int ch, ldp_t *p, size_t chunk, void *userdata,
+		int (*sink)(void *userdata, PICT *pic, 
+			const unsigned char *buf, size_t len));
+
+/* same as doc_get_picture_stream, but DEFLATE compressed 
+ * metafile (EMF, WMF, PICT) is inflated with input and 
+ * output windows of chunk bytes and sink gets uncompressed
+ * data (pic->len is uncompressed size). Return DOC_ERR_FILE
+ * if libdoc is built without zlib and picture is 
+ * compressed */
+int doc_get_picture_inflate(
+		int ch, ldp_t *p, size_t chunk, void *userdata,
+		int (*sink)(void *userdata, PICT *pic, 
+			const unsigned char *buf, size_t len));
+
+/* write picture data for INLINE_PICTURE or FLOATING_PICTURE
+ * character to file descriptor fd - return non-zero on 
+ * error */
+int doc_get_picture_fd(int ch, ldp_t *p, int fd);
+
+/* run sink for every picture of document without text 
+ * decoding - pictures of OfficeArtBStoreContainer and 
+ * inline pictures of Data stream are read in stream offset 
+ * order, pictures referenced several times (the same
+ * location or UID) are passed once. blip->pic.data is valid
+ * only while sink runs. Return DOC_CB_STOP if sink returns
+ * non-zero, or other error code */
+int doc_extract_pictures(libdoc_t *doc, void *userdata,
+		int (*sink)(void *userdata, ldb_t *blip));
+
+/* set process-wide log level and sink for messages of
+ * library (NULL - print to stderr). Messages are rate 
+ * limited by DOC_LOG_BURST for each place in code */
+void doc_set_log(int level, void *userdata,
+		void (*sink)(void *userdata, int level, const char *msg));
+
+/* run callback for each place in code with messages and
+ * number of messages (including rate limited) */
+void doc_log_counters(void *userdata,
+		void (*callback)(void *userdata, int level, 
+			const char *file, int line, const char *func, 
+			unsigned long count));
+
+/* start process-wide recording of begin and end events of
+ * parsing phases (reading of document structures, styles,
+ * sections, table rows, pictures) to preallocated ring 
+ * buffer of capacity events - oldest events are 
+ * overwritten. Capacity 0 stops recording and frees buffer.
+ * Should be called when no document is parsed. Return 
+ * non-zero on error */
+int doc_trace_start(size_t capacity);
+
+/* stop recording of events - recorded events are kept */
+void doc_trace_stop();
+
+/* write recorded events to fp in Chrome trace event format
+ * (JSON) for chrome://tracing or Perfetto. Should be called
+ * when no document is parsed. Return non-zero on error */
+int doc_trace_write(FILE *fp);
+
+/* picture UID cache: lock-free set of MD4 digests of 
+ * pictures (BLIP UID) shared by threads of process */
+typedef struct doc_uid_cache doc_uid_cache_t;
+
+/* allocate cache for capacity pictures - return NULL on 
+ * error */
+doc_uid_cache_t *doc_uid_cache_new(size_t capacity);
+
+/* free cache - it should not be used by predicate */
+void doc_uid_cache_free(doc_uid_cache_t *cache);
+
+/* predicate for doc_set_uid_seen with cache as userdata -
+ * return non-zero if uid is in cache */
+int doc_uid_cache_seen(void *cache, const unsigned char uid[16]);
+
+/* mark for doc_set_uid_seen with cache as userdata - add 
+ * uid to cache */
+void doc_uid_cache_mark(void *cache, const unsigned char uid[16]);
+
+/* set process-wide predicate for picture extraction: 
+ * doc_get_picture and doc_extract_pictures do not read and
+ * do not pass pictures for which seen returns non-zero, and
+ * call mark (if not NULL) for picture after it is read and
+ * passed to callback, so picture that failed to read is
+ * not skipped later. Threads that meet the same picture at
+ * once may both pass it. Set NULL to disable. Should be 
+ * called before documents are parsed */
+void doc_set_uid_seen(
+		int (*seen)(void *userdata, const unsigned char uid[16]),
+		void (*mark)(void *userdata, const unsigned char uid[16]),
+		void *userdata);
+
+/* get picture anchored at CP of main document - return 
+ * non-zero if there is no picture at CP */
+int doc_get_picture_at_cp(
+		libdoc_t *doc, unsigned long cp, void *userdata,
+		void (*callback)(struct picture *pic, void *userdata));
+
 #ifdef __cplusplus
 }
 #endif
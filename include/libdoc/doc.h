@@ -2,7 +2,7 @@
  * File              : doc.h
  * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
  * Date              : 04.11.2022
- * Last Modified Date: 07.08.2024
+ * Last Modified Date: 18.10.2026
  * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
  */
 
@@ -25,6 +25,9 @@ extern "C"{
 #include "../../ms-cfb/cfb.h"
 #include "alloc.h"
 #include "../../ms-cfb/log.h"
+#include "log.h"
+#include "probes.h"
+#include "trace.h"
 #include "../../ms-cfb/byteorder.h"
 #include "str.h"
 
@@ -132,17 +135,6 @@ typedef uint32_t ULONG;
  * objects, and records are little-endian
  */
 
-/*
- * Error codes
- */
-enum {
-	DOC_NO_ERR,     //no error
-	DOC_CB_STOP,    //stopped by callback
-	DOC_ERR_FILE,   //error to read file
-	DOC_ERR_HEADER, //error to read header
-	DOC_ERR_ALLOC,  //memory allocation error
-};
-
 /* 2.2.1 Character Position (CP)
  * A character position, which is also known as a CP, is an
  * unsigned 32-bit integer that serves as the
@@ -3423,6 +3415,22 @@ struct Clx {
 							//(variable): A Pcdt.
 };
 
+/* Find the largest i such that a[i] ≤ v in array of n
+ * elements of PLC (aCp or aFc, sorted in ascending order) 
+ * with binary search. Return -1 if a[0] > v */
+static int plc_search(const ULONG *a, int n, ULONG v)
+{
+	int lo = 0, hi = n;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (a[mid] <= v)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo - 1;
+}
+
 /* The PnFkpPapx structure specifies the offset of a PapxFkp 
  * in the WordDocument Stream.*/
 typedef LONG PnFkpPapx;
@@ -3760,6 +3768,14 @@ struct PapxFkp {
 									 // field occupies the last byte
 };
 
+// set PapxFkp fields from 512 bytes page
+static void papxFkp_set(struct PapxFkp *papxFkp, BYTE buf[512])
+{
+	papxFkp->cpara = buf[511];
+	papxFkp->rgfc = (ULONG *)buf;
+	papxFkp->rgbx = (struct BxPap *)(&(buf[(papxFkp->cpara + 1)*4]));
+}
+
 static void papxFkp_init(
 		struct PapxFkp *papxFkp, BYTE buf[512],
 		FILE *fp, ULONG offset)
@@ -3836,6 +3852,14 @@ struct ChpxFkp {
 									//bytes.
 }; 
 
+// set ChpxFkp fields from 512 bytes page
+static void chpxFkp_set(struct ChpxFkp *chpxFkp, BYTE buf[512])
+{
+	chpxFkp->crun = buf[511];
+	chpxFkp->rgfc = (ULONG *)buf;
+	chpxFkp->rgb = &(buf[(chpxFkp->crun + 1)*4]);
+}
+
 static void chpxFkp_init(
 		struct ChpxFkp *chpxFkp, BYTE buf[512],
 		FILE *fp, ULONG offset)
@@ -4405,6 +4429,14 @@ void STSH_free(struct STSH *stsh);
 struct LPStd *LPStd_at_index(
 		BYTE *rglpstd, int cstd, int index);
 
+/* LPStd at index of style sheet of document - offsets 
+ * are indexed once when STSH is loaded */
+struct LPStd *doc_lpstd(struct cfb_doc *doc, int index);
+
+/* index offsets of LPStd in rglpstd of size bytes - 
+ * without index doc_lpstd walks rglpstd */
+void doc_lpstd_index(struct cfb_doc *doc, ULONG size);
+
 /* 2.9.336 UpxChpx
  * The UpxChpx structure specifies the character formatting
  * properties that differ from the parent style
@@ -5248,6 +5280,31 @@ struct PICF {
 												//and MUST be ignored.
 };
 
+/* [MS-ODRAW] 2.2.31 OfficeArtMetafileHeader
+ * The OfficeArtMetafileHeader record specifies how to
+ * process a metafile. */
+struct OfficeArtMetafileHeader {
+	ULONG cbSize;         //(4 bytes): An unsigned integer that
+												//specifies the uncompressed size,
+												//in bytes, of the metafile.
+	struct Rca rcBounds;  //(16 bytes): A RECT structure that
+												//specifies the clipping region of
+												//the metafile.
+	LONG ptSizeX;         //(8 bytes): A POINT structure that
+	LONG ptSizeY;         //specifies the size, in EMUs, of
+												//the metafile.
+	ULONG cbSave;         //(4 bytes): An unsigned integer that
+												//specifies the compressed size, in
+												//bytes, of the metafile.
+	BYTE compression;     //(1 byte): An unsigned integer that
+												//specifies the compression method
+												//of the metafile: 0x00 - DEFLATE,
+												//0xFE - no compression.
+	BYTE filter;          //(1 byte): An unsigned integer that
+												//MUST be 0xFE.
+};
+#define OfficeArtMetafileHeaderSize 34
+
 /* The OfficeArtBlipEMF record specifies BLIP file data for
  * the enhanced metafile format (EMF).*/
 struct OfficeArtBlipEMF {
@@ -5849,12 +5906,92 @@ struct PlcfSed {
 };
 
 
+/* BStoreEntry
+ * Location of BLIP record of OfficeArtBStoreContainerFileBlock
+ * - it is found once when BLIP store is loaded */
+struct BStoreEntry {
+	USHORT recType;       //type of BLIP record
+											 //(OfficeArtRecTypeOfficeArtBlip*) or 0
+											 //if there is no BLIP for entry
+	BYTE btWin32;         //MSOBLIPTYPE of BLIP from
+											 //OfficeArtFBSE
+	BYTE rgbUid[16];      //MD4 UID of BLIP from OfficeArtFBSE
+	ULONG size;           //size of BLIP record with header
+	FILE *fp;             //stream of BLIP record - Table 
+											 //Stream or WordDocument Stream
+											 //for delayed BLIP
+	ULONG off;            //offset of BLIP record header in 
+											 //stream
+};
+
+/* OfficeArtDggContainer
+ * The location of the OfficeArtBStoreContainer (BLIP store)
+ * inside the OfficeArtContent at FibRgFcLcb97.fcDggInfo of
+ * the Table Stream */
+struct DggInfo {
+	ULONG fcBStore;       //offset of the first
+											 //OfficeArtBStoreContainerFileBlock
+											 //in the Table Stream
+	ULONG lcbBStore;      //size of OfficeArtBStoreContainer
+											 //records
+	USHORT cBStore;       //number of records in
+											 //OfficeArtBStoreContainer
+	struct BStoreEntry *rgfb;
+											 //BLIP location for each
+											 //OfficeArtBStoreContainerFileBlock
+	int nrgfb;            //number of entries in rgfb
+};
+
+/*
+ * Parts of document which are loaded on first access
+ */
+enum {
+	DOC_LOAD_TABLE      = 1 << 0, //Table stream
+	DOC_LOAD_DATA       = 1 << 1, //Data stream
+	DOC_LOAD_CLX        = 1 << 2, //Clx with PlcPcd
+	DOC_LOAD_PLCBTEPAPX = 1 << 3, //PlcBtePapx
+	DOC_LOAD_PLCBTECHPX = 1 << 4, //PlcBteChpx
+	DOC_LOAD_PLCFSPA    = 1 << 5, //PlcfSpa
+	DOC_LOAD_PLCFSED    = 1 << 6, //PlcfSed
+	DOC_LOAD_STSH       = 1 << 7, //style sheet
+	DOC_LOAD_DGGINFO    = 1 << 8, //OfficeArt DggInfo
+};
+
+/* inline picture parsed from PICFAndOfficeArtData at
+ * sprmCPicLocation in Data stream */
+struct PicfCacheEntry {
+	LONG picLocation;     // sprmCPicLocation
+	int  ret;             // 0 - picture is found
+	ldb_t blip;           // picture geometry and location
+};
+
+/* work budget of document - limits are checked every 
+ * DOC_BUDGET_STEP iterations of parsing loops */
+#define DOC_BUDGET_STEP 1024
+struct DocBudget {
+	unsigned long max_iterations; // 0 - no limit
+	unsigned long max_bytes;      // 0 - no limit
+	double max_seconds;           // CPU time, 0 - no limit
+	unsigned long iterations;     // iterations done
+	unsigned long bytes;          // bytes read
+	double start;                 // CPU time at start
+	int exceeded;                 // budget is exceeded
+};
+
+/* one page cache of FKP */
+struct DocFkpCache {
+	ULONG offset;         // offset of page in WordDocument
+	int   valid;          // page is read
+	BYTE  page[512];
+};
+
 /*
  * MS-DOC Structure.
  */
 
 typedef struct cfb_doc 
 {
+	struct cfb *cfb;      //compound file
 	FILE *WordDocument;   //document stream
 	FILE *Table;          //table stream
 	FILE *Data;           //data stream
@@ -5862,6 +5999,8 @@ typedef struct cfb_doc
 	Fib  fib;             //File information block
 	struct Clx clx;       //clx data
 	bool biteOrder;				//need to change byte order
+	int loaded;           //parts of document loaded 
+	int failed;           //parts of document failed to load
 	struct PlcBtePapx *plcbtePapx;
 	int plcbtePapxNaFc;   // number of aFc in plcbteChpx
 	struct PlcBteChpx *plcbteChpx;
@@ -5871,15 +6010,154 @@ typedef struct cfb_doc
 	struct PlcfSed *plcfSed;
 	int plcfSedNaCP;      // number of aCP in plcfSed;
 	struct STSH STSH;     // style sheet 
+	ULONG *aLPStd;        // offset of LPStd in rglpstd by
+	int naLPStd;          // istd (-1 if there is no LPStd)
+	struct DggInfo dggInfo; // OfficeArt drawing group
+	struct PicfCacheEntry *picfCache; 
+	int npicfCache;       // sorted by picLocation
+	int picfCacheCap;     // allocated entries of picfCache
+	int stop;             // error code to stop parsing
+	struct DocBudget budget; // work budget
+	int styleDepth;       // nesting of applied styles
+	BYTE styleVisited[0x1000/8]; // istd applied by resolution
+	struct DocFkpCache chpxCache; // last ChpxFkp page
+	struct DocFkpCache papxCache; // last PapxFkp page
+	lds_t stats;          // parsing statistics
+	int cancel;           // cancel flag (atomic access)
+	unsigned long progress; // parsed CP (atomic access)
+	unsigned long progressTotal; // CP to parse
+	void *progressData;
+	int (*progressCb)(void *userdata, 
+			unsigned long cp, unsigned long total);
+	unsigned long max_chars; // max CP to parse (0 - all)
+	int reference;        // reference mode - no caches
+	int textOnly;         // text without style properties
 	ldp_t prop;           // properties
 } cfb_doc_t;
 
 
-// open streams and read doc struct
-int  doc_read( cfb_doc_t *doc, struct cfb *cfb);
+// load part of document (DOC_LOAD_*) if it is not 
+// loaded yet - return non-zero on error
+int  doc_load(cfb_doc_t *doc, int part);
+
+// read FKP page at offset of WordDocument using one page
+// cache - return NULL on error
+BYTE *doc_fkp_page(cfb_doc_t *doc, struct DocFkpCache *cache,
+		ULONG offset);
+
+// monotonic time in seconds
+double doc_clock();
+
+// check work budget - set doc->stop to DOC_ERR_BUDGET 
+// and return non-zero if it is exceeded
+int  doc_budget_check(cfb_doc_t *doc);
+
+// reset counters of work budget and start CPU clock - 
+// called at start of each parsing function
+void doc_budget_start(cfb_doc_t *doc);
 
-// free memory and close streams
+// return non-zero if picture with uid is already seen by 
+// predicate set with doc_set_uid_seen
+int  doc_uid_seen(const unsigned char uid[16]);
+// remember uid of picture passed to callback
+void doc_uid_mark(const unsigned char uid[16]);
+
+// read BLIPFileData of blip to heap and run callback with
+// picture - return non-zero on error
+int  doc_picture_read(ldb_t *blip, void *userdata,
+		void (*callback)(struct picture *pic, void *userdata));
+
+// free memory, close streams and compound file and free
+// document opened with doc_open
 void doc_close(cfb_doc_t *doc);
+
+/* accessors to lazy loaded structures - return NULL if 
+ * the structure can not be loaded */
+static FILE *doc_table(cfb_doc_t *doc){
+	if (!(doc->loaded & DOC_LOAD_TABLE) && 
+			doc_load(doc, DOC_LOAD_TABLE))
+		return NULL;
+	return doc->Table;
+}
+
+static FILE *doc_data(cfb_doc_t *doc){
+	if (!(doc->loaded & DOC_LOAD_DATA) && 
+			doc_load(doc, DOC_LOAD_DATA))
+		return NULL;
+	return doc->Data;
+}
+
+static struct PlcPcd *doc_plcpcd(cfb_doc_t *doc){
+	if (!(doc->loaded & DOC_LOAD_CLX) && 
+			doc_load(doc, DOC_LOAD_CLX))
+		return NULL;
+	return &doc->clx.Pcdt->PlcPcd;
+}
+
+static struct PlcBtePapx *doc_plcbtePapx(cfb_doc_t *doc){
+	if (!(doc->loaded & DOC_LOAD_PLCBTEPAPX) && 
+			doc_load(doc, DOC_LOAD_PLCBTEPAPX))
+		return NULL;
+	return doc->plcbtePapx;
+}
+
+static struct PlcBteChpx *doc_plcbteChpx(cfb_doc_t *doc){
+	if (!(doc->loaded & DOC_LOAD_PLCBTECHPX) && 
+			doc_load(doc, DOC_LOAD_PLCBTECHPX))
+		return NULL;
+	return doc->plcbteChpx;
+}
+
+// return NULL if there is no shapes in main document
+static struct PlcfSpa *doc_plcfspa(cfb_doc_t *doc){
+	if (!(doc->loaded & DOC_LOAD_PLCFSPA) && 
+			doc_load(doc, DOC_LOAD_PLCFSPA))
+		return NULL;
+	return doc->plcfspa;
+}
+
+static struct PlcfSed *doc_plcfSed(cfb_doc_t *doc){
+	if (!(doc->loaded & DOC_LOAD_PLCFSED) && 
+			doc_load(doc, DOC_LOAD_PLCFSED))
+		return NULL;
+	return doc->plcfSed;
+}
+
+static struct STSH *doc_stsh(cfb_doc_t *doc){
+	if (!(doc->loaded & DOC_LOAD_STSH) && 
+			doc_load(doc, DOC_LOAD_STSH))
+		return NULL;
+	return &doc->STSH;
+}
+
+static struct DggInfo *doc_dgginfo(cfb_doc_t *doc){
+	if (!(doc->loaded & DOC_LOAD_DGGINFO) && 
+			doc_load(doc, DOC_LOAD_DGGINFO))
+		return NULL;
+	return &doc->dggInfo;
+}
+
+// count iteration of parsing loop - return non-zero if 
+// work budget is exceeded
+static int doc_budget_step(cfb_doc_t *doc){
+	if (doc->budget.exceeded)
+		return 1;
+	if (++doc->budget.iterations % DOC_BUDGET_STEP)
+		return 0;
+	return doc_budget_check(doc);
+}
+
+// return non-zero if doc_cancel is called - cancel flag is
+// cleared, so next parsing is not canceled
+static int doc_canceled(cfb_doc_t *doc){
+	return __atomic_exchange_n(&doc->cancel, 0, __ATOMIC_RELAXED);
+}
+
+// count bytes read from document streams
+static void doc_budget_read(cfb_doc_t *doc, unsigned long n){
+	doc->budget.bytes += n;
+	doc->stats.bytes += n;
+}
 	
 #ifdef __cplusplus
 }
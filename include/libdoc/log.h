@@ -0,0 +1,73 @@
+/**
+ * File              : log.h
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+/**
+ * log.h
+ * Copyright (c) 2026 Igor V. Sementsov <ig.kuzm@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* runtime log levels for ERR and LOG messages of library.
+ * Each place in code with ERR or LOG has static counter
+ * of messages. Message below log level costs one branch,
+ * other messages are counted and rate limited before
+ * going to log sink */
+
+#ifndef LIBDOC_LOG_H
+#define LIBDOC_LOG_H
+
+#include "../libdoc.h"
+
+/* place in code with log message */
+struct doc_log_site {
+	const char *file;
+	const char *func;
+	int line;
+	int level;
+	unsigned long count;         // number of messages
+	struct doc_log_site *next;   // list of sites with
+	                             // messages
+};
+
+/* current log level */
+extern int doc_log_level;
+
+/* count message of site and pass it to log sink if it is
+ * not rate limited */
+void doc_log(struct doc_log_site *site, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+#define DOC_LOG(lvl, ...) \
+({ \
+	if (__builtin_expect(doc_log_level >= (lvl), 0)){ \
+		static struct doc_log_site _site = \
+			{__FILE__, __func__, __LINE__, (lvl), 0, NULL}; \
+		doc_log(&_site, __VA_ARGS__); \
+	} \
+})
+
+/* replace ERR and LOG of ms-cfb/log.h */
+#undef ERR
+#undef LOG
+#define ERR(...) DOC_LOG(DOC_LOG_ERR,   __VA_ARGS__)
+#define LOG(...) DOC_LOG(DOC_LOG_DEBUG, __VA_ARGS__)
+
+#endif /* ifndef LIBDOC_LOG_H */
+// vim:ft=c
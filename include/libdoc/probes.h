@@ -0,0 +1,63 @@
+/**
+ * File              : probes.h
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+/**
+ * probes.h
+ * Copyright (c) 2026 Igor V. Sementsov <ig.kuzm@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* USDT static probes of provider libdoc. Library built with
+ * --enable-probes and <sys/sdt.h> has a NOP at each probe,
+ * so bpftrace or perf can attach to running process:
+ *   bpftrace -e 'usdt:libdoc.so:libdoc:fkp__load {...}'
+ * Without probes macros expand to nothing.
+ *
+ * probe                arguments
+ * doc__open            doc
+ * doc__close           doc
+ * section__start       doc, section index, first CP
+ * paragraph__start     doc, first CP, last CP
+ * paragraph__end       doc, CP after paragraph
+ * fkp__load            doc, offset of FKP page
+ * style__resolve       doc, istd
+ * picture__extract     doc, offset of BLIPFileData, length
+ * callback__invoke     doc, CP */
+
+#ifndef LIBDOC_PROBES_H
+#define LIBDOC_PROBES_H
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define DOC_PROBE1(name, a) \
+	DTRACE_PROBE1(libdoc, name, a)
+#define DOC_PROBE2(name, a, b) \
+	DTRACE_PROBE2(libdoc, name, a, b)
+#define DOC_PROBE3(name, a, b, c) \
+	DTRACE_PROBE3(libdoc, name, a, b, c)
+#else
+/* statements even if probes are disabled */
+#define DOC_PROBE1(name, a)       do {} while (0)
+#define DOC_PROBE2(name, a, b)    do {} while (0)
+#define DOC_PROBE3(name, a, b, c) do {} while (0)
+#endif
+
+#endif /* ifndef LIBDOC_PROBES_H */
+// vim:ft=c
@@ -3,7 +3,9 @@
 
 #include "doc.h"
 
-void get_char_for_cp(cfb_doc_t *doc, CP cp,
+/* run callback for character at cp - return callback 
+ * return value */
+int get_char_for_cp(cfb_doc_t *doc, CP cp,
 		void *user_data,
 		DOC_PART part,
 		int (*callback)(void *user_data, DOC_PART part, ldp_t *p, int ch));
@@ -0,0 +1,61 @@
+/**
+ * File              : trace.h
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+/**
+ * trace.h
+ * Copyright (c) 2026 Igor V. Sementsov <ig.kuzm@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* timeline of parsing phases. Events are stored to ring 
+ * buffer allocated by doc_trace_start - recording of event
+ * is clock read and store to slot, no allocation or I/O.
+ * Without tracing event costs one branch */
+
+#ifndef LIBDOC_TRACE_H
+#define LIBDOC_TRACE_H
+
+#include "../libdoc.h"
+
+struct doc_trace_event {
+	const char *name;    // static string
+	char ph;             // 'B' - begin, 'E' - end
+	unsigned int tid;    // number of thread
+	double ts;           // seconds of doc_clock
+	long arg;            // section index, CP etc
+};
+
+/* tracing is on */
+extern int doc_trace_on;
+
+/* store event to ring buffer */
+void doc_trace_event(char ph, const char *name, long arg);
+
+#define DOC_TRACE(ph, name, arg) \
+({ \
+	if (__builtin_expect(doc_trace_on, 0)) \
+		doc_trace_event((ph), (name), (arg)); \
+})
+
+#define DOC_TRACE_BEGIN(name, arg) DOC_TRACE('B', name, arg)
+#define DOC_TRACE_END(name, arg)   DOC_TRACE('E', name, arg)
+
+#endif /* ifndef LIBDOC_TRACE_H */
+// vim:ft=c
@@ -2,7 +2,7 @@
  * File              : apply_properties.c
  * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
  * Date              : 28.05.2024
- * Last Modified Date: 07.08.2024
+ * Last Modified Date: 18.10.2026
  * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
  */
 
@@ -24,6 +24,7 @@ int apply_property(cfb_doc_t *doc, int l, struct Prl *prl)
 #ifdef DEBUG
 	LOG("sgc: 0x%X", sgc);
 #endif
+	doc->stats.sprms++;
 	switch (sgc) {
 		case sgcCha:
 			return apply_char_property(doc, l, prl);
@@ -37,6 +38,8 @@ int apply_property(cfb_doc_t *doc, int l, struct Prl *prl)
 			return apply_picture_property(doc, prl);
 		
 		default:
+			doc->stats.sprms--;
+			doc->stats.sprmsUnknown++;
 			break;
 	}
 
@@ -2,7 +2,7 @@
  * File              : cell_boundaries.c
  * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
  * Date              : 26.05.2024
- * Last Modified Date: 17.07.2024
+ * Last Modified Date: 18.10.2026
  * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
  */
 
@@ -45,7 +45,10 @@ CP last_cp_in_cell(cfb_doc_t *doc, CP cp)
 			
 			memset(&doc->prop.tcp, 0, sizeof(TCP));
 			
-			cp = last_cp_in_paragraph(doc, cp+1);
+			CP next = last_cp_in_paragraph(doc, cp+1);
+			if (next == CPERROR || next <= cp)
+				return CPERROR;
+			cp = next;
 		
 			// check if TTP
 			if (doc->prop.pap.TTP)
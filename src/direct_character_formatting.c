@@ -2,7 +2,7 @@
  * File              : direct_character_formatting.c
  * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
  * Date              : 27.05.2024
- * Last Modified Date: 07.08.2024
+ * Last Modified Date: 18.10.2026
  * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
  */
 
@@ -59,7 +59,9 @@ void direct_character_formatting(
 /* 2. Read a PlcBteChpx at offset FibRgFcLcb97.fcPlcfBteChpx
  * in the Table Stream, and of size
  * FibRgFcLcb97.lcbPlcfBteChpx.*/
-	struct PlcBteChpx *plcbteChpx = doc->plcbteChpx;
+	struct PlcBteChpx *plcbteChpx = doc_plcbteChpx(doc);
+	if (!plcbteChpx)
+		return;
 
 /* 3. Find the largest i such that plcbteChpx.aFc[i] ≤ fc.
  * If the last element of plcbteChpx.aFc is less
@@ -67,16 +69,6 @@ void direct_character_formatting(
  * character positions in this document, and is
  * not valid. Read a ChpxFkp at offset aPnBteChpx[i].pn *512
  * in the WordDocument Stream. */
-	int i;
-	for (i=0; plcbteChpx->aFc[i] <= fc;)
-		i++;
-	i--;
-
-#ifdef DEBUG
-	LOG("plcbteChpx->aFc[%d]: %d", 
-			i, plcbteChpx->aFc[i]);
-#endif
-
 	if (plcbteChpx->aFc[doc->plcbteChpxNaFc - 1] <= fc){
 		ERR("plcbteChpx->aFc[%d]: %d - cp is outside the range "
 				"of character positions in this document, and is "
@@ -86,27 +78,38 @@ void direct_character_formatting(
 		return;
 	}
 
+	int i = plc_search(plcbteChpx->aFc, 
+			doc->plcbteChpxNaFc, fc);
+	if (i < 0)
+		return;
+
+#ifdef DEBUG
+	LOG("plcbteChpx->aFc[%d]: %d", 
+			i, plcbteChpx->aFc[i]);
+#endif
+
 	ULONG chpxFkp_fc = pnFkpChpx_pn(
-					doc->plcbteChpx->aPnBteChpx[i]) * 512;
+					plcbteChpx->aPnBteChpx[i]) * 512;
 #ifdef DEBUG
 	LOG("chpxFkp offset: %d", chpxFkp_fc);
 #endif
 
 	struct ChpxFkp chpxFkp;
-	BYTE buf[512];	
-	chpxFkp_init(&chpxFkp, buf, doc->WordDocument, 
-				chpxFkp_fc);
+	BYTE *buf = doc_fkp_page(doc, &doc->chpxCache, chpxFkp_fc);
+	if (!buf)
+		return;
+	chpxFkp_set(&chpxFkp, buf);
 
 /* 4. Find the largest j such that ChpxFkp.rgfc[j] ≤ fc. If
  * the last element of ChpxFkp.rgfc is less than
  * or equal to fc, then cp is outside the range of character
  * positions in this document, and is not
  * valid. Find a Chpx at offset ChpxFkp.rgb[i] in ChpxFkp.*/
-	int j;
-	for (j = 0; chpxFkp.rgfc[j] <= fc;)
-		j++;
-	j--;
-
+	// crun is 0x01 - 0x65, rgb follows rgfc in page
+	if (chpxFkp.crun == 0 || chpxFkp.crun > 0x65){
+		ERR("ChpxFkp.crun is out of range: %d", chpxFkp.crun);
+		return;
+	}
 	if (chpxFkp.rgfc[chpxFkp.crun] <= fc){
 		ERR("chpxFkp->rgfc[%d]: %d - cp is outside the range "
 				"of character positions in this document, and is "
@@ -116,20 +119,30 @@ void direct_character_formatting(
 		return;
 	}
 
-	ULONG offset = chpxFkp.rgb[j] * 2 + chpxFkp_fc;
-	BYTE cb;
-	fseek(doc->WordDocument, offset,
-		 	SEEK_SET);
-	fread(&cb, 1, 1,
-		 	doc->WordDocument);
+	int j;
+	for (j = 0; j < chpxFkp.crun && chpxFkp.rgfc[j] <= fc;)
+		j++;
+	j--;
+	if (j < 0)
+		return;
+
+	// Chpx is in the page at rgb[j] * 2 - 0 means no Chpx
+	// and default properties
+	int off = chpxFkp.rgb[j] * 2;
+	if (off == 0)
+		return;
+	
+	BYTE cb = buf[off];
 #ifdef DEBUG
 	LOG("cb: %d", cb);
 #endif
+	if (off + 1 + cb > 511){
+		ERR("Chpx at %d with cb %d is out of ChpxFkp", off, cb);
+		return;
+	}
 
 	/* GrpPrl has size of chpx.cb */
-	BYTE grpprl[cb];	
-	fread(grpprl, cb, 1, 
-			doc->WordDocument);
+	BYTE *grpprl = &buf[off + 1];	
 
 #ifdef DEBUG
 	//char str[BUFSIZ] = "grpprl: ";
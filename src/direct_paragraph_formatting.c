@@ -2,7 +2,7 @@
  * File              : direct_paragraph_formatting.c
  * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
  * Date              : 26.05.2024
- * Last Modified Date: 28.07.2024
+ * Last Modified Date: 18.10.2026
  * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
 */
 
@@ -64,6 +64,7 @@ void direct_paragraph_formatting(
 #endif
 	fseek(doc->WordDocument, offset,
 			SEEK_SET);
+	doc->stats.seeks++;
 	
 /* 3. Find a GrpprlAndIstd in the PapxInFkp from step 2.
  * The offset and size of the GrpprlAndIstd
@@ -113,6 +114,7 @@ void direct_paragraph_formatting(
 	BYTE grpprl[size-2];
 	fread(grpprl, size-2, 1,
 			doc->WordDocument);
+	doc_budget_read(doc, size + 1);
 	parse_grpprl(
 			grpprl, 
 			size-2, 
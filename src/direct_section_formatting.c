@@ -2,7 +2,7 @@
  * File              : direct_section_formatting.c
  * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
  * Date              : 05.08.2024
- * Last Modified Date: 05.08.2024
+ * Last Modified Date: 18.10.2026
  * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
  */
 
@@ -20,6 +20,10 @@ void direct_section_formatting(cfb_doc_t *doc, int index)
 	LOG("start");
 #endif
 
+	struct PlcfSed *plcfSed = doc_plcfSed(doc);
+	if (!plcfSed)
+		return;
+
 	if (index >= doc->plcfSedNaCP){
 		ERR("no section with index: %d", index);
 		return;
@@ -27,7 +31,7 @@ void direct_section_formatting(cfb_doc_t *doc, int index)
 
 	memset(&doc->prop.sep, 0, sizeof(SEP));
 	
-	LONG off = doc->plcfSed->aSed[index].fcSepx;
+	LONG off = plcfSed->aSed[index].fcSepx;
 	fseek(doc->WordDocument, off, SEEK_SET);
 	
 	// read size of grpprl
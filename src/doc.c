@@ -2,12 +2,20 @@
  * File              : doc.c
  * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
  * Date              : 26.05.2024
- * Last Modified Date: 07.08.2024
+ * Last Modified Date: 18.10.2026
  * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
  */
 
 #include "../include/libdoc/doc.h"
+#include "../include/libdoc/prl.h"
+#include "../include/libdoc/sprm.h"
 #include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
 
 /* How to read the FIB
  * The Fib structure is located at offset 0 of the
@@ -256,7 +264,11 @@ static int _doc_fib_init(Fib *fib, FILE *fp, struct cfb *cfb){
 				fp) != 1)
 	{
 		ERR("fread");
-		return -1;
+		free(fib->base);
+		free(fib->rgW97);
+		free(fib->rgLw97);
+		free(fib->rgFcLcb);
+		return DOC_ERR_FILE;
 	}
 
 #ifdef DEBUG
@@ -289,6 +301,7 @@ static int _doc_fib_init(Fib *fib, FILE *fp, struct cfb *cfb){
 			free(fib->rgW97);
 			free(fib->rgLw97);
 			free(fib->rgFcLcb);
+			free(fib->rgCswNew);
 			return DOC_ERR_FILE;
 		}	
 		if (cfb->biteOrder){
@@ -327,49 +340,49 @@ int _doc_plcfspa_init(cfb_doc_t *doc){
 	FibRgFcLcb97 *rgFcLcb97 = (FibRgFcLcb97 *)(doc->fib.rgFcLcb);
 	ULONG off = rgFcLcb97->fcPlcSpaMom;
 	ULONG len = rgFcLcb97->lcbPlcSpaMom;
-	ULONG ccpText =doc->fib.rgLw97->ccpText;
 
 	if (len <= 0 || off <= 0) // there is no shapes in 
 														// main document
 		return 0;
 
-	// read cp's
+	FILE *Table = doc_table(doc);
+	if (!Table)
+		return DOC_ERR_FILE;
+
+	// PlcfSpa has n + 1 CP and n Spa of 26 bytes
+	int i, n = len < 4 ? 0 : (len - 4) / (4 + 26);
 	doc->plcfspa = 
 		NEW(struct PlcfSpa, 
 				ERR("NEW"); 
 				return -1);
 	doc->plcfspa->aCP = 
-		NEW(CP, return -1);
-
-	fseek(doc->Table, off, SEEK_SET);
-	
-	int i;
-	CP cp = 0;
-	for (i=0; cp >= 0 && cp <= ccpText; ++i){
-		if (fread(&cp, sizeof(CP), 1,
-				doc->Table) < 1)
-			break;
-		doc->plcfspa->aCP[i] = cp;
-		doc->plcfspa->aCP = 
-			REALLOC(doc->plcfspa->aCP, (i+1)*sizeof(CP), 
-					ERR("realloc"); 
-					return -1);
-	}
-	doc->plcfspaNaCP = i-1;
-
-	// read aSpa
+		ALLOC((n + 1) * sizeof(CP), 
+				ERR("alloc"); 
+				return -1);
 	doc->plcfspa->aSpa = 
-		ALLOC(doc->plcfspaNaCP * sizeof(struct Spa),
+		ALLOC((n ? n : 1) * sizeof(struct Spa),
 				ERR("alloc"); 
 				return -1);
 
+	// read cp's
+	fseek(Table, off, SEEK_SET);
+	if (fread(doc->plcfspa->aCP, sizeof(CP), n + 1,
+				Table) != n + 1)
+	{
+		ERR("fread");
+		return -1;
+	}
+
+	// read aSpa
 	struct Spa spa;
-	for (i = 0; i < doc->plcfspaNaCP; ++i) {
+	memset(&spa, 0, sizeof(spa));
+	for (i = 0; i < n; ++i) {
 		if (fread(&spa, 26, 1,
-				doc->Table) < 1)
+				Table) < 1)
 			break;
 		doc->plcfspa->aSpa[i] = spa;
 	}
+	doc->plcfspaNaCP = i;
 	
 #ifdef DEBUG
 	LOG("PlcfSpa:");
@@ -392,11 +405,14 @@ int _doc_plcfSed_init(cfb_doc_t *doc){
 	ULONG len = rgFcLcb97->lcbPlcfSed;
 
 	if (len <= 0 || off <= 0){
-		// some error 
-		ERR("unknown error");
-		return 1;
+		ERR("no PlcfSed in document");
+		return DOC_ERR_FILE;
 	}
 
+	FILE *Table = doc_table(doc);
+	if (!Table)
+		return DOC_ERR_FILE;
+
 	// number of cp is len/(12 + 4) + 1 CP
 	doc->plcfSedNaCP = len / 16 + 1;
 
@@ -410,29 +426,29 @@ int _doc_plcfSed_init(cfb_doc_t *doc){
 	doc->plcfSed->aSed = (struct Sed *) 
 		ALLOC(sizeof(struct Sed) * (doc->plcfSedNaCP - 1), return -1);
 
-	fseek(doc->Table, off, SEEK_SET);
+	fseek(Table, off, SEEK_SET);
 	fread(doc->plcfSed->aCP, sizeof(CP),
-			doc->plcfSedNaCP, doc->Table);
+			doc->plcfSedNaCP, Table);
 
 	
-	// read aSpa
+	// read aSed - one less than aCP
 	int i;
-	for (i = 0; i < doc->plcfSedNaCP; ++i) {
+	for (i = 0; i < doc->plcfSedNaCP - 1; ++i) {
 		// skeep fn
-		fseek(doc->Table, 2, SEEK_CUR);
+		fseek(Table, 2, SEEK_CUR);
 		LONG fcSepx;
 		fread(&fcSepx, 4,
-				1, doc->Table);
+				1, Table);
 		doc->plcfSed->aSed[i].fcSepx = fcSepx;
 		// skeep fnMpr
-		fseek(doc->Table, 2, SEEK_CUR);
+		fseek(Table, 2, SEEK_CUR);
 		// skeep fcMpr
-		fseek(doc->Table, 4, SEEK_CUR);
+		fseek(Table, 4, SEEK_CUR);
 	}
 	
 #ifdef DEBUG
 	LOG("PlcfSed with NaCP: %d", doc->plcfSedNaCP);
-	for (i = 0; i < doc->plcfSedNaCP; ++i) {
+	for (i = 0; i < doc->plcfSedNaCP - 1; ++i) {
 		LOG("CP: %d, fcSepx: %d", 
 				doc->plcfSed->aCP[i], doc->plcfSed->aSed[i].fcSepx);
 	}
@@ -442,6 +458,41 @@ int _doc_plcfSed_init(cfb_doc_t *doc){
 }
 
 
+/* merge pieces which are contiguous in CP and in 
+ * WordDocument stream and have the same fCompressed, Prm 
+ * and flags - fast-saved documents have thousands of small
+ * pieces, and most of them continue previous piece. Text 
+ * of each piece begins at FcValue(fc) for Unicode and at
+ * FcValue(fc) / 2 for compressed, so in both cases next 
+ * piece continues piece of len CP if its FcValue is 
+ * 2 * len bytes more */
+static void _plcpcd_coalesce(struct PlcPcd *PlcPcd)
+{
+	int n = PlcPcd->aPcdl;
+	if (n < 2 || PlcPcd->aCPl != n + 1)
+		return;
+
+	int i, k = 0;
+	for (i = 1; i < n; ++i) {
+		struct Pcd *a = &PlcPcd->aPcd[k];
+		struct Pcd *b = &PlcPcd->aPcd[i];
+		ULONG len = PlcPcd->aCp[i] - PlcPcd->aCp[k];
+		if (FcCompressed(a->fc) == FcCompressed(b->fc) &&
+				a->prm == b->prm && a->ABCfR2 == b->ABCfR2 &&
+				FcValue(b->fc) == FcValue(a->fc) + 2 * len)
+			continue;
+		k++;
+		PlcPcd->aCp[k] = PlcPcd->aCp[i];
+		PlcPcd->aPcd[k] = *b;
+	}
+	PlcPcd->aCp[k + 1] = PlcPcd->aCp[n];
+	PlcPcd->aPcdl = k + 1;
+	PlcPcd->aCPl = k + 2;
+#ifdef DEBUG
+	LOG("coalesced %d pieces to %d", n, k + 1);
+#endif	
+}
+
 int _plcpcd_init(struct PlcPcd * PlcPcd, uint32_t len, cfb_doc_t *doc){
 #ifdef DEBUG
 	LOG("start");
@@ -477,7 +528,7 @@ int _plcpcd_init(struct PlcPcd * PlcPcd, uint32_t len, cfb_doc_t *doc){
 	//read aCP
 	i=0;
 	uint32_t ch;
-	while(fread(&ch, 4, 1,
+	while(i*4 < len && fread(&ch, 4, 1,
 				doc->Table) == 1)
 	{
 		if (doc->biteOrder){
@@ -498,6 +549,7 @@ int _plcpcd_init(struct PlcPcd * PlcPcd, uint32_t len, cfb_doc_t *doc){
 		void *ptr = REALLOC(PlcPcd->aCp, (i+1)*4,
 				ERR("realloc");
 				break);
+		PlcPcd->aCp = ptr;
 	}
 #ifdef DEBUG
 	LOG("number of cp in array: %d", i);
@@ -514,7 +566,8 @@ int _plcpcd_init(struct PlcPcd * PlcPcd, uint32_t len, cfb_doc_t *doc){
 	LOG("number of Pcd in array: %d", PlcPcd->aPcdl);
 #endif	
 	
-	PlcPcd->aPcd = (struct Pcd *)ALLOC(size,
+	PlcPcd->aPcd = (struct Pcd *)ALLOC(
+			sizeof(struct Pcd) * PlcPcd->aPcdl,
 			ERR("malloc");
 			free(PlcPcd->aCp);	
 			free(PlcPcd);	
@@ -555,6 +608,9 @@ int _plcpcd_init(struct PlcPcd * PlcPcd, uint32_t len, cfb_doc_t *doc){
 		PlcPcd->aPcd[i] = Pcd;
 	}
 
+	// reference mode walks pieces as they are in file
+	if (!doc->reference)
+		_plcpcd_coalesce(PlcPcd);
 	
 #ifdef DEBUG
 	LOG("done");
@@ -593,6 +649,9 @@ static int _clx_init(cfb_doc_t *doc)
 
 	struct Clx *clx = &doc->clx;
 	
+	if (!doc_table(doc))
+		return DOC_ERR_FILE;
+
 	//get clx
 	uint8_t ch;
 	fseek(doc->Table, fcClx, SEEK_SET);
@@ -717,6 +776,8 @@ static int _doc_plcBtePapx_init(cfb_doc_t *doc){
 #endif
 	FibRgFcLcb97 *fibRgFcLcb97 = 
 		(FibRgFcLcb97 *)(doc->fib.rgFcLcb);
+	if (!doc_table(doc))
+		return DOC_ERR_FILE;
 	doc->plcbtePapx = 
 			plcbtePapx_get(
 					doc->Table, 
@@ -736,6 +797,8 @@ static int _doc_plcBteChpx_init(cfb_doc_t *doc){
 #endif
 	FibRgFcLcb97 *fibRgFcLcb97 = 
 		(FibRgFcLcb97 *)(doc->fib.rgFcLcb);
+	if (!doc_table(doc))
+		return DOC_ERR_FILE;
 	doc->plcbteChpx = 
 			plcbteChpx_get(
 					doc->Table, 
@@ -772,6 +835,9 @@ int _doc_STSH_init(cfb_doc_t *doc)
 		return -1;
 	}
 	
+	if (!doc_table(doc))
+		return DOC_ERR_FILE;
+
 	BYTE *buf = (BYTE *)ALLOC(lcb, ERR("alloc"); return -1);
 	
 	fseek(doc->Table, fc, SEEK_SET);
@@ -779,6 +845,7 @@ int _doc_STSH_init(cfb_doc_t *doc)
 			 	doc->Table) != 1)
 	{
 		ERR("fread");
+		free(buf);
 		return -1;
 	}
 	doc->STSH.lpstshi = (struct LPStshi *)buf;
@@ -792,18 +859,232 @@ int _doc_STSH_init(cfb_doc_t *doc)
 	}
 
 	int off = doc->STSH.lpstshi->cbStshi + 2;
+	if (lcb < off || lcb < 2 + sizeof(struct Stshif)){
+		ERR("STSH corrupted, cbStshi: %d, lcbStshf: %d", 
+				doc->STSH.lpstshi->cbStshi, lcb);
+		return DOC_ERR_FILE;
+	}
 	doc->STSH.rglpstd = &buf[off];
 
+	// index offsets of LPStd - walk of rglpstd for each
+	// style is O(cstd)
+	doc_lpstd_index(doc, lcb - off);
 	return 0;
 }
 
+void doc_lpstd_index(cfb_doc_t *doc, ULONG size)
+{
+	int cstd = doc->STSH.lpstshi->stshi->stshif.cstd;
+	doc->aLPStd = (ULONG *)ALLOC(cstd * sizeof(ULONG) + 1, 
+			ERR("alloc"); return);
+	doc->naLPStd = cstd;
+	
+	ULONG i = 0;
+	int k;
+	for (k = 0; k < cstd; ++k) {
+		if (i + 2 > size){
+			doc->aLPStd[k] = (ULONG)-1;
+			continue;
+		}
+		doc->aLPStd[k] = i;
+		SHORT cbStd;
+		memcpy(&cbStd, &doc->STSH.rglpstd[i], 2);
+		if (cbStd < 0 || i + 2 + cbStd > size){
+			ERR("STSH corrupted, LPStd at index: %d, cbStd: %d", 
+					k, cbStd);
+			i = size;
+			continue;
+		}
+		i += cbStd + 2;
+	}
+}
+
+struct LPStd *doc_lpstd(cfb_doc_t *doc, int index)
+{
+	// reference mode walks rglpstd
+	if (doc->reference || !doc->aLPStd)
+		return LPStd_at_index(doc->STSH.rglpstd, 
+				doc->STSH.lpstshi->stshi->stshif.cstd, index);
+	
+	if (index < 0 || index >= doc->naLPStd || 
+			doc->aLPStd[index] == (ULONG)-1)
+		return NULL;
+	return (struct LPStd *)&doc->STSH.rglpstd[doc->aLPStd[index]];
+}
+
 void STSH_free(struct STSH *stsh){
 	if (stsh->lpstshi)
 		free(stsh->lpstshi);
 }
 
 
-int doc_read(cfb_doc_t *doc, struct cfb *cfb){
+/* read OfficeArtDggContainer headers and find the
+ * OfficeArtBStoreContainer */
+static int _doc_dgginfo_init(cfb_doc_t *doc)
+{
+#ifdef DEBUG
+	LOG("start");
+#endif
+	FibRgFcLcb97 *rgFcLcb97 = (FibRgFcLcb97 *)(doc->fib.rgFcLcb);
+	ULONG off = rgFcLcb97->fcDggInfo;
+	ULONG len = rgFcLcb97->lcbDggInfo;
+	// documents without drawings have no OfficeArtContent
+	if (len == 0)
+		return -1;
+
+	FILE *Table = doc_table(doc);
+	if (!Table)
+		return DOC_ERR_FILE;
+
+	fseek(Table, off, SEEK_SET);
+	
+	// read OfficeArtDggContainer header
+	struct OfficeArtRecordHeader rh;
+	if (fread(&rh, OfficeArtRecordHeaderSize, 1,
+			Table) != 1)
+	{
+		ERR("fread");
+		return DOC_ERR_FILE;
+	}
+#ifdef DEBUG
+	LOG("OfficeArtDggContainer type: 0x%X, len: %d", rh.recType, rh.recLen);
+#endif
+	
+	if (rh.recType != OfficeArtRecTypeOfficeArtDggContainer)
+	{
+		ERR(" this is not OfficeArtDggContainer");
+		return DOC_ERR_FILE;
+	}
+	// read OfficeArtFDGGBlock header
+	fread(&rh, OfficeArtRecordHeaderSize, 1,
+			Table);
+	
+#ifdef DEBUG
+	LOG("OfficeArtFDGGBlock type: 0x%X, len: %d", rh.recType, rh.recLen);
+#endif
+
+	if (rh.recType != OfficeArtRecTypeOfficeArtFDggBlock)
+	{
+		ERR(" this is not OfficeArtFDggBlock");
+		return DOC_ERR_FILE;
+	}
+	// skip block
+	fseek(Table, 
+			rh.recLen, SEEK_CUR);
+
+	// read BLip Store header
+	fread(&rh, OfficeArtRecordHeaderSize, 1,
+			Table);
+		
+#ifdef DEBUG
+	LOG("OfficeArtBStoreContainer type: 0x%X, len: %d, number of records: %d", 
+			rh.recType, rh.recLen, OfficeArtRecordHeaderRecInstance(&rh));
+#endif
+
+	if (rh.recType != OfficeArtRecTypeOfficeArtBStoreContainer)
+	{
+		ERR(" this is not OfficeArtBStoreContainer");
+		return DOC_ERR_FILE;
+	}
+
+	struct DggInfo *dggInfo = &doc->dggInfo;
+	dggInfo->fcBStore  = ftell(Table);
+	dggInfo->lcbBStore = rh.recLen;
+	dggInfo->cBStore   = OfficeArtRecordHeaderRecInstance(&rh);
+
+	if (dggInfo->cBStore == 0)
+		return 0;
+
+	// index BLIP store - find type, size, UID and location
+	// of BLIP for each record
+	dggInfo->rgfb = (struct BStoreEntry *)ALLOC(
+			dggInfo->cBStore * sizeof(struct BStoreEntry),
+			ERR("alloc");
+			return DOC_ERR_ALLOC);
+
+	off = dggInfo->fcBStore;
+	ULONG end = dggInfo->fcBStore + dggInfo->lcbBStore;
+	int i;
+	for (i = 0; 
+			i < dggInfo->cBStore && 
+			off + OfficeArtRecordHeaderSize <= end; 
+			++i)
+	{
+		struct BStoreEntry *e = &dggInfo->rgfb[i];
+		
+		fseek(Table, off, SEEK_SET);
+		if (fread(&rh, OfficeArtRecordHeaderSize, 1,
+				Table) != 1)
+		{
+			ERR("fread");
+			break;
+		}
+
+		if (rh.recType == OfficeArtRecTypeOfficeArtFBSE){
+			struct OfficeArtFBSE t;	
+			memset(&t, 0, sizeof(struct OfficeArtFBSE));
+			fread(&t.btWin32, 1, 1,  Table);
+			fread(&t.btMacOS, 1, 1,  Table);
+			fread(t.rgbUid,   1, 16, Table);
+			fread(&t.tag,     2, 1,  Table);
+			fread(&t.size,    4, 1,  Table);
+			fread(&t.cRef,    4, 1,  Table);
+			fread(&t.foDelay, 4, 1,  Table);
+			fread(&t.unused1, 1, 1,  Table);
+			fread(&t.cbName,  1, 1,  Table);
+			fread(&t.unused2, 1, 1,  Table);
+			fread(&t.unused3, 1, 1,  Table);
+
+			e->btWin32 = t.btWin32;
+			memcpy(e->rgbUid, t.rgbUid, 16);
+			e->size = t.size;
+			
+			if (rh.recLen > 36 + t.cbName){
+				// BLIP is embedded in FBSE record
+				e->fp  = Table;
+				e->off = off + OfficeArtRecordHeaderSize + 
+					36 + t.cbName;
+			} else if (t.size > 0 && t.foDelay != 0xFFFFFFFF){
+				// the image is in OfficeArtBStoreDelay
+				e->fp  = doc->WordDocument;
+				e->off = t.foDelay;
+			}
+			
+			// get BLIP type
+			if (e->fp){
+				struct OfficeArtRecordHeader bh;
+				fseek(e->fp, e->off, SEEK_SET);
+				if (fread(&bh, OfficeArtRecordHeaderSize, 1,
+						e->fp) == 1)
+					e->recType = bh.recType;
+				else
+					e->fp = NULL;
+			}
+
+		} else {
+			// BLIP record without FBSE
+			e->recType = rh.recType;
+			e->size    = rh.recLen + OfficeArtRecordHeaderSize;
+			e->fp      = Table;
+			e->off     = off;
+		}
+		
+#ifdef DEBUG
+	LOG("BStore[%d]: type: 0x%X, size: %d, offset: %d", 
+			i, e->recType, e->size, e->off);
+#endif
+		
+		off += OfficeArtRecordHeaderSize + rh.recLen;
+	}
+	dggInfo->nrgfb = i;
+
+	return 0;
+}
+
+/* open WordDocument stream and read FIB - other 
+ * structures are loaded on first access. Document and cfb
+ * are owned by doc_open and freed by doc_close */
+static int doc_read(cfb_doc_t *doc, struct cfb *cfb){
 #ifdef DEBUG
 	LOG("start");
 #endif
@@ -811,6 +1092,8 @@ int doc_read(cfb_doc_t *doc, struct cfb *cfb){
 	memset(doc, 0, sizeof(cfb_doc_t));
 	
 	int ret = 0;
+	doc->cfb = cfb;
+	
 	//get byte order
 	doc->biteOrder = cfb->biteOrder;
 	
@@ -822,58 +1105,115 @@ int doc_read(cfb_doc_t *doc, struct cfb *cfb){
 	doc->WordDocument = fp;
 
 	//init FIB
-	_doc_fib_init(&(doc->fib), doc->WordDocument, cfb);
-
-	//get table
-	doc->Table = _table_stream(doc, cfb);
-	if (!doc->Table){
-		ERR("Can't get Table stream"); 
-		return DOC_ERR_FILE;
+	ret = _doc_fib_init(&(doc->fib), doc->WordDocument, cfb);
+	if (ret){
+		// FIB memory is already freed
+		memset(&(doc->fib), 0, sizeof(Fib));
+		return ret;
 	}
 
-	//get Data
-	doc->Data = cfb_get_stream(cfb, (char*)"Data");
+	/* Table and Data streams, Clx, PlcBtePapx, PlcBteChpx,
+	 * PlcfSpa, PlcfSed, STSH and DggInfo are loaded on 
+	 * first access with doc_load */
 
-	//Read the Clx from the Table Stream
-	ret = _clx_init(doc);
-	if (ret)
-		return ret;	
+#ifdef DEBUG
+	LOG("done");
+#endif	
+	return 0;
+}
 
-	// get PlcBtePapx
-	ret = _doc_plcBtePapx_init(doc);
-	if (ret)
-		return ret;	
-	
-	// get PlcBteChpx
-	ret = _doc_plcBteChpx_init(doc);
-	if (ret)
-		return ret;	
+/* name of doc_load part for trace */
+static const char *_load_name(int part)
+{
+	switch (part) {
+		case DOC_LOAD_TABLE:      return "_table_stream";
+		case DOC_LOAD_DATA:       return "Data";
+		case DOC_LOAD_CLX:        return "_clx_init";
+		case DOC_LOAD_PLCBTEPAPX: return "_doc_plcBtePapx_init";
+		case DOC_LOAD_PLCBTECHPX: return "_doc_plcBteChpx_init";
+		case DOC_LOAD_PLCFSPA:    return "_doc_plcfspa_init";
+		case DOC_LOAD_PLCFSED:    return "_doc_plcfSed_init";
+		case DOC_LOAD_STSH:       return "_doc_STSH_init";
+		case DOC_LOAD_DGGINFO:    return "_doc_dgginfo_init";
+	}
+	return "doc_load";
+}
 
-	// get PlcfSpa
-	ret = _doc_plcfspa_init(doc);
-	if (ret)
-		return ret;	
+int doc_load(cfb_doc_t *doc, int part)
+{
+	if (doc->loaded & part)
+		return 0;
+	
+	// do not try to load broken part again
+	if (doc->failed & part)
+		return DOC_ERR_FILE;
 
-	// get PlcfSed
-	ret = _doc_plcfSed_init(doc);
-	if (ret)
-		return ret;	
+#ifdef DEBUG
+	LOG("load part: 0x%X", part);
+#endif
 	
+	int ret = 0;
+	DOC_TRACE_BEGIN(_load_name(part), part);
+	switch (part) {
+		case DOC_LOAD_TABLE:
+			{
+				doc->Table = _table_stream(doc, doc->cfb);
+				if (!doc->Table){
+					ERR("Can't get Table stream"); 
+					ret = DOC_ERR_FILE;
+				}
+				break;
+			}
+		case DOC_LOAD_DATA:
+			// Data stream is optional
+			doc->Data = cfb_get_stream(doc->cfb, (char*)"Data");
+			break;
+		case DOC_LOAD_CLX:
+			//Read the Clx from the Table Stream
+			ret = _clx_init(doc);
+			break;
+		case DOC_LOAD_PLCBTEPAPX:
+			ret = _doc_plcBtePapx_init(doc);
+			break;
+		case DOC_LOAD_PLCBTECHPX:
+			ret = _doc_plcBteChpx_init(doc);
+			break;
+		case DOC_LOAD_PLCFSPA:
+			ret = _doc_plcfspa_init(doc);
+			break;
+		case DOC_LOAD_PLCFSED:
+			ret = _doc_plcfSed_init(doc);
+			break;
+		case DOC_LOAD_STSH:
+			ret = _doc_STSH_init(doc);
+			break;
+		case DOC_LOAD_DGGINFO:
+			ret = _doc_dgginfo_init(doc);
+			break;
+		
+		default:
+			ERR("unknown part: 0x%X", part);
+			DOC_TRACE_END(_load_name(part), part);
+			return -1;
+	}
+	DOC_TRACE_END(_load_name(part), part);
 
-	// get STSH
-	ret = _doc_STSH_init(doc);
 	if (ret)
-		return ret;	
+		doc->failed |= part;
+	else
+		doc->loaded |= part;
 
-#ifdef DEBUG
-	LOG("done");
-#endif	
-	return 0;
+	return ret;
 }
 
+/* stats of document last closed by thread */
+static __thread lds_t _last_stats;
+
 void doc_close(cfb_doc_t *doc)
 {
 	if (doc){
+		DOC_PROBE1(doc__close, doc);
+		_last_stats = doc->stats;
 		if (doc->fib.base)
 			free(doc->fib.base);
 		if (doc->fib.rgW97)
@@ -885,12 +1225,12 @@ void doc_close(cfb_doc_t *doc)
 		if (doc->fib.rgCswNew)
 			free(doc->fib.rgCswNew);
 		
-		if (doc->plcbteChpx)
-			free(doc->plcbteChpx);
-		if (doc->plcbtePapx)
-			free(doc->plcbtePapx);
+		plcbteChpx_free(doc->plcbteChpx);
+		plcbtePapx_free(doc->plcbtePapx);
 		
 		STSH_free(&doc->STSH);
+		if (doc->aLPStd)
+			free(doc->aLPStd);
 		
 		if (doc->plcfspa){
 			if(doc->plcfspa->aCP)
@@ -899,6 +1239,11 @@ void doc_close(cfb_doc_t *doc)
 				free(doc->plcfspa->aSpa);
 			free(doc->plcfspa);
 		}
+		if (doc->dggInfo.rgfb)
+			free(doc->dggInfo.rgfb);
+		if (doc->picfCache)
+			free(doc->picfCache);
+
 		if (doc->plcfSed){
 			if(doc->plcfSed->aCP)
 				free(doc->plcfSed->aCP);
@@ -930,642 +1275,1272 @@ void doc_close(cfb_doc_t *doc)
 			fclose(doc->WordDocument);
 		if (doc->Data)
 			fclose(doc->Data);
+		
+		if (doc->cfb){
+			cfb_close(doc->cfb);
+			free(doc->cfb);
+		}
+		free(doc);
 	}
-/* TODO: free memory and close streams */
 }
 
-static void image_from_OfficeArtBlipJPEG(
-		FILE *fp, 
-		struct OfficeArtRecordHeader *rh, 
-		struct picture *pic,
-		void *userdata,
-		void (*callback)(struct picture *pic, void *userdata))
+libdoc_t *doc_open(const char *filename, int *err)
 {
-	struct OfficeArtBlipJPEG t;
-	memset(&t, 0, sizeof(struct OfficeArtBlipJPEG));
+#ifdef DEBUG
+	LOG("start");
+#endif
+	int ret;
+	
+	libdoc_t *doc = NEW(cfb_doc_t, 
+			ERR("NEW");
+			if (err) *err = DOC_ERR_ALLOC;
+			return NULL);
+
+	struct cfb *cfb = NEW(struct cfb,
+			ERR("NEW");
+			free(doc);
+			if (err) *err = DOC_ERR_ALLOC;
+			return NULL);
+	
+	// get CFB
+	double t = doc_clock();
+	ret = cfb_open(cfb, filename);
+	if (ret){
+		free(cfb);
+		free(doc);
+		if (err) *err = ret;
+		return NULL;
+	}
+	
+	// Read the FIB
+	DOC_TRACE_BEGIN("doc_read", 0);
+	ret = doc_read(doc, cfb);
+	DOC_TRACE_END("doc_read", ret);
+	if (ret){
+		doc_close(doc);
+		if (err) *err = ret;
+		return NULL;
+	}
+
+	doc->prop.data = doc;
+	doc->stats.tRead = doc_clock() - t;
+	DOC_PROBE1(doc__open, doc);
+	
+	if (err) *err = 0;
+	return doc;
+}
 
-	t.rh = *rh;
-	fread(t.rgbUid1, 1, 16, fp);
+double doc_clock()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
-	USHORT recInstance = OfficeArtRecordHeaderRecInstance(rh);
-	if (
-			recInstance != 0x46A && recInstance != 0x6E2 &&
-			recInstance != 0x46B && recInstance != 0x6E3
-			)
+BYTE *doc_fkp_page(cfb_doc_t *doc, struct DocFkpCache *cache,
+		ULONG offset)
+{
+	if (cache->valid && cache->offset == offset && 
+			!doc->reference)
 	{
-		ERR("this is not OfficeArtBlipJPEG - recInstance not match");
-		return;
+		doc->stats.fkpHits++;
+		return cache->page;
 	}
 
-	if (recInstance == 0x46B || recInstance == 0x6E3){
-		fread(t.rgbUid2, 1, 16, fp);
+	cache->valid = 0;
+	DOC_PROBE2(fkp__load, doc, offset);
+	doc->stats.seeks++;
+	fseek(doc->WordDocument, offset, SEEK_SET);
+	if (fread(cache->page, 512, 1, doc->WordDocument) != 1){
+		ERR("fread");
+		return NULL;
 	}
-	
-	fread(&t.tag, 1, 1, fp);
+	doc_budget_read(doc, 512);
+	doc->stats.fkpReads++;
 
-	if (rh->recLen){
-		// read BLIP data
-		BYTE BLIPFileData[rh->recLen];
-		fread(&BLIPFileData, rh->recLen, 1, fp);
-		t.BLIPFileData = BLIPFileData;
+	cache->offset = offset;
+	cache->valid = 1;
+	return cache->page;
+}
 
-		pic->type = pict_jpg;
-		pic->data = BLIPFileData;
-		pic->len  = rh->recLen;
+void doc_get_stats(libdoc_t *doc, lds_t *stats)
+{
+	*stats = doc ? doc->stats : _last_stats;
+}
 
-		if (callback)
-			callback(pic, userdata);
-	}
-};
+/* CPU time of thread in seconds */
+static double _cpu_time()
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+		return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+	return (double)clock() / CLOCKS_PER_SEC;
+}
 
-static void image_from_OfficeArtBlipTIFF(
-		FILE *fp, 
-		struct OfficeArtRecordHeader *rh, 
-		struct picture *pic,
-		void *userdata,
-		void (*callback)(struct picture *pic, void *userdata))
+void doc_set_budget(libdoc_t *doc, unsigned long max_iterations,
+		double max_seconds, unsigned long max_bytes)
 {
-	struct OfficeArtBlipTIFF t;
-	memset(&t, 0, sizeof(struct OfficeArtBlipTIFF));
+	memset(&doc->budget, 0, sizeof(struct DocBudget));
+	doc->budget.max_iterations = max_iterations;
+	doc->budget.max_seconds    = max_seconds;
+	doc->budget.max_bytes      = max_bytes;
+}
 
-	t.rh = *rh;
-	fread(t.rgbUid1, 1, 16, fp);
+void doc_budget_start(cfb_doc_t *doc)
+{
+	struct DocBudget *b = &doc->budget;
+	b->iterations = 0;
+	b->bytes      = 0;
+	b->exceeded   = 0;
+	b->start      = _cpu_time();
+}
 
-	USHORT recInstance = OfficeArtRecordHeaderRecInstance(rh);
-	if (recInstance != 0x6E4 && recInstance != 0x6E5){
-		ERR("this is not OfficeArtBlipTIFF - recInstance not match");
-		return;
+int doc_budget_check(cfb_doc_t *doc)
+{
+	struct DocBudget *b = &doc->budget;
+	if (!b->exceeded){
+		if (b->max_iterations && b->iterations > b->max_iterations){
+			ERR("work budget: more than %lu iterations", 
+					b->max_iterations);
+			b->exceeded = 1;
+		} else if (b->max_bytes && b->bytes > b->max_bytes){
+			ERR("work budget: more than %lu bytes read", 
+					b->max_bytes);
+			b->exceeded = 1;
+		} else if (b->max_seconds && 
+				_cpu_time() - b->start > b->max_seconds)
+		{
+			ERR("work budget: more than %g seconds", 
+					b->max_seconds);
+			b->exceeded = 1;
+		}
 	}
 
-	if (recInstance == 0x6E5){
-		fread(t.rgbUid2, 1, 16, fp);
-	}
-	
-	fread(&t.tag, 1, 1, fp);
+	if (b->exceeded)
+		doc->stop = DOC_ERR_BUDGET;
+	return b->exceeded;
+}
 
-	if (rh->recLen){
-		// read BLIP data
-		BYTE BLIPFileData[rh->recLen];
-		fread(&BLIPFileData, rh->recLen, 1, fp);
-		t.BLIPFileData = BLIPFileData;
+void doc_set_progress(libdoc_t *doc, void *userdata,
+		int (*progress)(void *userdata, 
+			unsigned long cp, unsigned long total))
+{
+	doc->progressData = userdata;
+	doc->progressCb = progress;
+}
 
-		pic->type = pict_tiff;
-		pic->data = BLIPFileData;
-		pic->len  = rh->recLen;
+unsigned long doc_get_progress(libdoc_t *doc, 
+		unsigned long *total)
+{
+	if (total)
+		*total = __atomic_load_n(
+				&doc->progressTotal, __ATOMIC_RELAXED);
+	return __atomic_load_n(&doc->progress, __ATOMIC_RELAXED);
+}
 
-		if (callback)
-			callback(pic, userdata);
-	}
-};
+void doc_cancel(libdoc_t *doc)
+{
+	__atomic_store_n(&doc->cancel, 1, __ATOMIC_RELAXED);
+}
 
-static void image_from_OfficeArtBlipDIB(
-		FILE *fp, 
-		struct OfficeArtRecordHeader *rh, 
-		struct picture *pic,
-		void *userdata,
-		void (*callback)(struct picture *pic, void *userdata))
+void doc_set_max_chars(libdoc_t *doc, unsigned long max_chars)
+{
+	doc->max_chars = max_chars;
+}
+
+void doc_set_text_only(libdoc_t *doc, int text_only)
 {
-	struct OfficeArtBlipDIB t;
-	memset(&t, 0, sizeof(struct OfficeArtBlipDIB));
+	doc->textOnly = text_only;
+}
 
-	t.rh = *rh;
-	fread(t.rgbUid1, 1, 16, fp);
+void doc_set_reference(libdoc_t *doc, int reference)
+{
+	doc->reference = reference;
+	doc->chpxCache.valid = 0;
+	doc->papxCache.valid = 0;
+}
 
-	USHORT recInstance = OfficeArtRecordHeaderRecInstance(rh);
-	if (recInstance != 0x7A8 && recInstance != 0x7A9){
-		ERR("this is not OfficeArtBlipDIB - recInstance not match");
-		return;
-	}
+int doc_get_info(libdoc_t *doc, ldi_t *info)
+{
+	if (!doc || !info)
+		return -1;
 
-	if (recInstance == 0x7A9){
-		fread(t.rgbUid2, 1, 16, fp);
-	}
+	memset(info, 0, sizeof(ldi_t));
 	
-	fread(&t.tag, 1, 1, fp);
-
-	if (rh->recLen){
-		// read BLIP data
-		BYTE BLIPFileData[rh->recLen];
-		fread(&BLIPFileData, rh->recLen, 1, fp);
-		t.BLIPFileData = BLIPFileData;
+	FibBase *base = doc->fib.base;
+	info->nFib        = base->nFib;
+	if (doc->fib.rgCswNew && doc->fib.rgCswNew->nFibNew)
+		info->nFib      = doc->fib.rgCswNew->nFibNew;
+	info->lid         = base->lid;
+	info->fDot        = FibBaseA(base);
+	info->fComplex    = FibBaseC(base);
+	info->fHasPic     = FibBaseD(base);
+	info->cQuickSaves = FibBaseE(base);
+	info->fEncrypted  = FibBaseF(base);
+	info->fFarEast    = FibBaseL(base);
+
+	FibRgLw97 *rgLw97 = doc->fib.rgLw97;
+	info->ccpText     = rgLw97->ccpText;
+	info->ccpFtn      = rgLw97->ccpFtn;
+	info->ccpHdd      = rgLw97->ccpHdd;
+	info->ccpAtn      = rgLw97->ccpAtn;
+	info->ccpEdn      = rgLw97->ccpEdn;
+	info->ccpTxbx     = rgLw97->ccpTxbx;
+	info->ccpHdrTxbx  = rgLw97->ccpHdrTxbx;
+
+	// PlcfSed has n+1 CP (4 bytes) and n Sed (12 bytes)
+	FibRgFcLcb97 *rgFcLcb97 = (FibRgFcLcb97 *)(doc->fib.rgFcLcb);
+	if (rgFcLcb97->lcbPlcfSed > 4)
+		info->nSections = (rgFcLcb97->lcbPlcfSed - 4) / 16;
 
-		pic->type = pict_dbitmap;
-		pic->data = BLIPFileData;
-		pic->len  = rh->recLen;
+	return 0;
+}
 
-		if (callback)
-			callback(pic, userdata);
-	}
+/* BLIP records [MS-ODRAW] 2.2.23 - 2.2.30. Each BLIP 
+ * starts with rgbUid1, then rgbUid2 if recInstance is 
+ * recInstance1 + 1, then 1-byte tag for bitmaps or 34-byte
+ * OfficeArtMetafileHeader for metafiles, then BLIPFileData */
+static const struct {
+	USHORT recType;
+	USHORT recInstance1;
+	BYTE   cbHeader;
+	PICT_T type;
+} _blip_types[] = {
+	{OfficeArtRecTypeOfficeArtBlipEMF,   0x3D4, 34, pict_emf},
+	{OfficeArtRecTypeOfficeArtBlipWMF,   0x216, 34, pict_wmf},
+	{OfficeArtRecTypeOfficeArtBlipPICT,  0x542, 34, pict_mac},
+	{OfficeArtRecTypeOfficeArtBlipJPEG,  0x46A, 1,  pict_jpg},
+	{OfficeArtRecTypeOfficeArtBlipJPEG,  0x6E2, 1,  pict_jpg},
+	{OfficeArtRecTypeOfficeArtBlipJPEG_, 0x46A, 1,  pict_jpg},
+	{OfficeArtRecTypeOfficeArtBlipJPEG_, 0x6E2, 1,  pict_jpg},
+	{OfficeArtRecTypeOfficeArtBlipPNG,   0x6E0, 1,  pict_png},
+	{OfficeArtRecTypeOfficeArtBlipDIB,   0x7A8, 1,  pict_dbitmap},
+	{OfficeArtRecTypeOfficeArtBlipTIFF,  0x6E4, 1,  pict_tiff},
 };
 
-static void image_from_OfficeArtBlipPICT(
-		FILE *fp, 
-		struct OfficeArtRecordHeader *rh, 
-		struct picture *pic,
-		void *userdata,
-		void (*callback)(struct picture *pic, void *userdata))
+/* read BLIP record with header rh from stream fp and fill 
+ * blip with type and location of BLIPFileData - picture 
+ * data itself is not read */
+static int _blip_locate(
+		FILE *fp, struct OfficeArtRecordHeader *rh, ldb_t *blip)
 {
-	struct OfficeArtBlipPICT t;
-	memset(&t, 0, sizeof(struct OfficeArtBlipPICT));
+	USHORT recInstance = OfficeArtRecordHeaderRecInstance(rh);
+	int i, n = sizeof(_blip_types)/sizeof(*_blip_types);
+	for (i = 0; i < n; ++i)
+		if (_blip_types[i].recType == rh->recType &&
+				(recInstance == _blip_types[i].recInstance1 ||
+				 recInstance == _blip_types[i].recInstance1 + 1))
+			break;
+	
+	if (i == n){
+		ERR("unknown BLIP type: 0x%X, recInstance: 0x%X", 
+				rh->recType, recInstance);
+		return -1;
+	}
 
-	t.rh = *rh;
-	fread(t.rgbUid1, 1, 16, fp);
+	// rgbUid1, rgbUid2 if any and tag or metafileHeader
+	ULONG cbHeader = 16 + _blip_types[i].cbHeader;
+	if (recInstance == _blip_types[i].recInstance1 + 1)
+		cbHeader += 16;
+	
+	if (rh->recLen < cbHeader){
+		ERR("BLIP record is too short: %d", rh->recLen);
+		return -1;
+	}
 
-	USHORT recInstance = OfficeArtRecordHeaderRecInstance(rh);
-	if (recInstance != 0x542 && recInstance != 0x543){
-		ERR("this is not OfficeArtBlipPICT - recInstance not match");
-		return;
+	if (fread(blip->uid, 16, 1, fp) != 1){
+		ERR("fread");
+		return -1;
 	}
 
-	if (recInstance == 0x543){
-		fread(t.rgbUid2, 1, 16, fp);
+	blip->pic.type = _blip_types[i].type;
+	blip->stream   = fp;
+	blip->offset   = ftell(fp) - 16 + cbHeader;
+
+	// recLen is not trusted - BLIPFileData is clamped to 
+	// the rest of stream
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	if (size < blip->offset){
+		ERR("BLIP record is out of stream: %ld", blip->offset);
+		return -1;
 	}
+	ULONG len = rh->recLen - cbHeader;
+	if (len > (ULONG)(size - blip->offset))
+		len = size - blip->offset;
+	blip->pic.len = len;
 	
-	fread(&t.metafileHeader, 1, 34, fp);
+	if (_blip_types[i].cbHeader == OfficeArtMetafileHeaderSize){
+		// metafile header is last before BLIPFileData
+		struct OfficeArtMetafileHeader mh;
+		fseek(fp, blip->offset - OfficeArtMetafileHeaderSize, 
+				SEEK_SET);
+		if (fread(&mh, OfficeArtMetafileHeaderSize, 1, fp) != 1){
+			ERR("fread");
+			return -1;
+		}
+		blip->pic.w = mh.rcBounds.right - mh.rcBounds.left;
+		blip->pic.h = mh.rcBounds.bottom - mh.rcBounds.top;
+		blip->cbSize = mh.cbSize;
+		blip->compressed = mh.compression == 0x00;
+	}
+	
+	return 0;
+}
 
-	if (rh->recLen){
-		// read BLIP data
-		BYTE BLIPFileData[rh->recLen];
-		fread(&BLIPFileData, rh->recLen, 1, fp);
-		t.BLIPFileData = BLIPFileData;
+/* big-endian and little-endian integers from bytes */
+#define _BE16(b) ((ULONG)(b)[0] << 8 | (b)[1])
+#define _BE32(b) (_BE16(b) << 16 | _BE16((b) + 2))
+#define _LE16(b) ((ULONG)(b)[1] << 8 | (b)[0])
+#define _LE32(b) (_LE16((b) + 2) << 16 | _LE16(b))
 
-		pic->type = pict_mac;
-		pic->data = BLIPFileData;
-		pic->len  = rh->recLen;
+/* read first len bytes of metafile from BLIPFileData -
+ * DEFLATE compressed metafile is inflated only up to len
+ * bytes. Return non-zero if metafile is shorter */
+static int _blip_metafile_head(ldb_t *blip, BYTE *b, size_t len)
+{
+	FILE *fp = blip->stream;
+	fseek(fp, blip->offset, SEEK_SET);
 
-		if (callback)
-			callback(pic, userdata);
+	if (!blip->compressed){
+		if (blip->pic.len < len || fread(b, len, 1, fp) != 1)
+			return -1;
+		return 0;
 	}
-};
 
-static void image_from_OfficeArtBlipWMF(
-		FILE *fp, 
-		struct OfficeArtRecordHeader *rh, 
-		struct picture *pic,
-		void *userdata,
-		void (*callback)(struct picture *pic, void *userdata))
-{
-	struct OfficeArtBlipWMF t;
-	memset(&t, 0, sizeof(struct OfficeArtBlipWMF));
+#ifdef HAVE_LIBZ
+	BYTE in[256];
+	z_stream zs;
+	memset(&zs, 0, sizeof(z_stream));
+	if (inflateInit(&zs) != Z_OK)
+		return -1;
 
-	t.rh = *rh;
-	fread(t.rgbUid1, 1, 16, fp);
+	size_t left = blip->pic.len;
+	int zret = Z_OK;
+	zs.next_out  = b;
+	zs.avail_out = len;
+	while (zs.avail_out > 0 && zret == Z_OK && left > 0) {
+		size_t n = left < sizeof(in) ? left : sizeof(in);
+		if (fread(in, n, 1, fp) != 1)
+			break;
+		left -= n;
+		zs.next_in  = in;
+		zs.avail_in = n;
+		while (zs.avail_out > 0 && zs.avail_in > 0 && 
+				zret == Z_OK)
+			zret = inflate(&zs, Z_NO_FLUSH);
+	}
+	int ret = zs.avail_out == 0 ? 0 : -1;
+	inflateEnd(&zs);
+	return ret;
+#else
+	return -1;
+#endif
+}
 
-	USHORT recInstance = OfficeArtRecordHeaderRecInstance(rh);
-	if (recInstance != 0x216 && recInstance != 0x217){
-		ERR("this is not OfficeArtBlipWMF - recInstance not match");
-		return;
-	}
+/* read few bytes from start of BLIPFileData to get bitmap 
+ * width and height in pixels: PNG IHDR, JPEG SOFn, DIB
+ * BITMAPINFOHEADER/BITMAPCOREHEADER, EMF header bounds or
+ * WMF placeable header bounds (at 96 DPI). Metafile 
+ * without header keeps OfficeArtMetafileHeader bounds */
+static void _blip_sniff_size(ldb_t *blip)
+{
+	BYTE b[44];
+	FILE *fp = blip->stream;
+	fseek(fp, blip->offset, SEEK_SET);
+
+	switch (blip->pic.type) {
+		case pict_emf:
+			// EMR_HEADER: type (4) is 1, size (4), 
+			// rclBounds (16) - inclusive device units, 
+			// rclFrame (16), signature " EMF" (4)
+			if (_blip_metafile_head(blip, b, 44))
+				return;
+			if (_LE32(b) != 1 || _LE32(b + 40) != 0x464D4520)
+				return;
+			{
+				LONG left   = _LE32(b + 8);
+				LONG top    = _LE32(b + 12);
+				LONG right  = _LE32(b + 16);
+				LONG bottom = _LE32(b + 20);
+				if (right < left || bottom < top)
+					return;
+				blip->pic.w = right - left + 1;
+				blip->pic.h = bottom - top + 1;
+			}
+			return;
 
-	if (recInstance == 0x217){
-		fread(t.rgbUid2, 1, 16, fp);
-	}
-	
-	fread(&t.metafileHeader, 1, 34, fp);
+		case pict_wmf:
+			// META_PLACEABLE: key (4), HWmf (2), BoundingBox
+			// (4 x 2) in logical units, Inch (2) - logical
+			// units per inch
+			if (_blip_metafile_head(blip, b, 16))
+				return;
+			if (_LE32(b) != 0x9AC6CDD7)
+				return;
+			{
+				short left   = _LE16(b + 6);
+				short top    = _LE16(b + 8);
+				short right  = _LE16(b + 10);
+				short bottom = _LE16(b + 12);
+				ULONG inch = _LE16(b + 14);
+				if (!inch || right < left || bottom < top)
+					return;
+				blip->pic.w = (right - left) * 96 / inch;
+				blip->pic.h = (bottom - top) * 96 / inch;
+			}
+			return;
 
-	if (rh->recLen){
-		// read BLIP data
-		BYTE BLIPFileData[rh->recLen];
-		fread(&BLIPFileData, rh->recLen, 1, fp);
-		t.BLIPFileData = BLIPFileData;
+		case pict_png:
+			// signature (8), IHDR length and type (8), 
+			// width (4), height (4)
+			if (blip->pic.len < 24 || fread(b, 24, 1, fp) != 1)
+				return;
+			if (memcmp(b + 12, "IHDR", 4))
+				return;
+			blip->pic.w = _BE32(b + 16);
+			blip->pic.h = _BE32(b + 20);
+			return;
+		
+		case pict_dbitmap:
+		case pict_ibitmap:
+			if (blip->pic.len < 12 || fread(b, 12, 1, fp) != 1)
+				return;
+			if (_LE32(b) == 12){
+				// BITMAPCOREHEADER
+				blip->pic.w = _LE16(b + 4);
+				blip->pic.h = _LE16(b + 6);
+			} else {
+				// BITMAPINFOHEADER - height is negative for
+				// top-down bitmap
+				blip->pic.w = (LONG)_LE32(b + 4);
+				blip->pic.h = labs((LONG)_LE32(b + 8));
+			}
+			return;
 
-		pic->type = pict_wmf;
-		pic->data = BLIPFileData;
-		pic->len  = rh->recLen;
+		case pict_jpg:
+			{
+				// walk markers to SOFn: FF Cn, length (2), 
+				// precision (1), height (2), width (2)
+				long end = blip->offset + blip->pic.len;
+				if (fread(b, 2, 1, fp) != 1 || _BE16(b) != 0xFFD8)
+					return;
+				while (ftell(fp) + 4 <= end) {
+					if (fread(b, 4, 1, fp) != 1 || b[0] != 0xFF)
+						return;
+					BYTE m = b[1];
+					if (m == 0xD8 || m == 0x01 || 
+							(m >= 0xD0 && m <= 0xD7))
+					{
+						// markers without length
+						fseek(fp, -2, SEEK_CUR);
+						continue;
+					}
+					if (m == 0xD9 || m == 0xDA)
+						return;
+					if (m >= 0xC0 && m <= 0xCF && 
+							m != 0xC4 && m != 0xC8 && m != 0xCC)
+					{
+						if (fread(b, 5, 1, fp) != 1)
+							return;
+						blip->pic.h = _BE16(b + 1);
+						blip->pic.w = _BE16(b + 3);
+						return;
+					}
+					ULONG len = _BE16(b + 2);
+					if (len < 2)
+						return;
+					fseek(fp, len - 2, SEEK_CUR);
+				}
+			}
+			return;
 
-		if (callback)
-			callback(pic, userdata);
+		default:
+			return;
 	}
-};
+}
 
-static void image_from_OfficeArtBlipEMF(
-		FILE *fp, 
-		struct OfficeArtRecordHeader *rh, 
-		struct picture *pic,
-		void *userdata,
-		void (*callback)(struct picture *pic, void *userdata))
+/* follow OfficeArtFBSE records with header rh to BLIP 
+ * record - return stream positioned after BLIP record 
+ * header or NULL on error */
+static FILE *_blip_from_OfficeArtFBSE(
+		FILE *fp, cfb_doc_t *doc, struct OfficeArtRecordHeader *rh)
 {
-	struct OfficeArtBlipEMF t;
-	memset(&t, 0, sizeof(struct OfficeArtBlipEMF));
+	while (rh->recType == OfficeArtRecTypeOfficeArtFBSE) {
+		struct OfficeArtFBSE t;	
+		memset(&t, 0, sizeof(struct OfficeArtFBSE));
+		fread(&t.btWin32, 1, 1,  fp);
+		fread(&t.btMacOS, 1, 1,  fp);
+		fread(t.rgbUid,   1, 16, fp);
+		fread(&t.tag,     2, 1,  fp);
+		fread(&t.size,    4, 1,  fp);
+		fread(&t.cRef,    4, 1,  fp);
+		fread(&t.foDelay, 4, 1,  fp);
+		fread(&t.unused1, 1, 1,  fp);
+		fread(&t.cbName,  1, 1,  fp);
+		fread(&t.unused2, 1, 1,  fp);
+		fread(&t.unused3, 1, 1,  fp);
+
+		// skip nameData
+		fseek(fp, t.cbName, SEEK_CUR);
+		
+		if (rh->recLen <= 36 + t.cbName){
+			// the image is in OfficeArtBStoreDelay
+			if (t.size == 0 || t.foDelay == 0xFFFFFFFF){
+				ERR("OfficeArtFBSE without BLIP");
+				return NULL;
+			}
+			fp = doc->WordDocument;
+			fseek(fp, t.foDelay, SEEK_SET);
+		}
+		
+		// read BLIP header
+		if (fread(rh, OfficeArtRecordHeaderSize, 1, fp) != 1){
+			ERR("fread");
+			return NULL;
+		}
 
-	t.rh = *rh;
-	fread(t.rgbUid1, 1, 16, fp);
+#ifdef DEBUG
+		LOG("BLIP with type: 0x%X and len %d",
+				rh->recType, rh->recLen);
+#endif
+	}
 
-	USHORT recInstance = OfficeArtRecordHeaderRecInstance(rh);
-	if (recInstance != 0x3D4 && recInstance != 0x3D5){
-		ERR("this is not OfficeArtBlipEMF - recInstance not match");
-		return;
+	return fp;
+}
+
+/* parse PICFAndOfficeArtData at sprmCPicLocation and 
+ * locate BLIP of picture */
+static int _inline_picture_parse(
+		cfb_doc_t *doc, FILE *Data, ldb_t *blip)
+{
+
+	//PICFAndOfficeArtData
+	struct PICFAndOfficeArtData t;
+	memset(&t, 0, 
+			sizeof(struct PICFAndOfficeArtData));
+	
+	// read PICF from stream
+	fseek(Data, 
+			doc->prop.chp.sprmCPicLocation,
+			SEEK_SET);
+	if (fread(&t, 68, 1, Data) != 1){
+		ERR("fread");
+		return -1;
 	}
 
-	if (recInstance == 0x3D5){
-		fread(t.rgbUid2, 1, 16, fp);
+	// skip PicName if needed
+	if (t.picf.mfpf.mm == MM_SHAPEFILE){
+		fread(&t.cchPicName,
+				1, 1, Data);
+		fseek(Data, t.cchPicName, SEEK_CUR);
 	}
-	
-	fread(&t.metafileHeader, 1, 34, fp);
 
-	if (rh->recLen){
-		// read BLIP data
-		BYTE BLIPFileData[rh->recLen];
-		fread(&BLIPFileData, rh->recLen, 1, fp);
-		t.BLIPFileData = BLIPFileData;
+	// read SpContainer header
+	struct OfficeArtRecordHeader spHeader;
+	fread(&spHeader,
+			OfficeArtRecordHeaderSize,
+			1, Data);
 
-		pic->type = pict_wmf;
-		pic->data = BLIPFileData;
-		pic->len  = rh->recLen;
+	if (spHeader.recType != 
+			OfficeArtRecTypeOfficeArtSpContainer)
+	{
+		ERR("This is not OfficeArtSpContainer");
+		return -1;
+	}
+
+	// skip SpContainer shape data
+	fseek(Data,
+			spHeader.recLen, SEEK_CUR);
 
-		if (callback)
-			callback(pic, userdata);
+	// read OfficeArtBStoreContainerFileBlock header
+	struct OfficeArtRecordHeader rh;
+	if (fread(&rh,
+			OfficeArtRecordHeaderSize,
+			1, Data) != 1)
+	{
+		ERR("fread");
+		return -1;
 	}
-};
 
-static void image_from_OfficeArtBlipPNG(
-		FILE *fp, 
-		struct OfficeArtRecordHeader *rh, 
-		struct picture *pic,
-		void *userdata,
-		void (*callback)(struct picture *pic, void *userdata))
-{
-	struct OfficeArtBlipPNG t;
-	memset(&t, 0, sizeof(struct OfficeArtBlipPNG));
+#ifdef DEBUG
+	LOG("OfficeArtBStoreContainerFileBlock with type: 0x%X and len %d",
+			rh.recType, rh.recLen);
+#endif
 
-	t.rh = *rh;
-	fread(t.rgbUid1, 1, 16, fp);
+	blip->pic.goalw  = t.picf.picmid.dxaGoal;
+	blip->pic.goalh  = t.picf.picmid.dyaGoal;
+	blip->pic.scalex = t.picf.picmid.mx;
+	blip->pic.scaley = t.picf.picmid.my;
 
+	FILE *fp = _blip_from_OfficeArtFBSE(Data, doc, &rh);
+	if (!fp)
+		return -1;
 
-	USHORT recInstance = OfficeArtRecordHeaderRecInstance(rh);
-	if (recInstance != 0x6E0 && recInstance != 0x6E1){
-		ERR("this is not OfficeArtBlipPNG - recInstance not match");
-		return;
-	}
+	return _blip_locate(fp, &rh, blip);
+}
 
-	if (recInstance == 0x6E1){
-		fread(t.rgbUid2, 1, 16, fp);
+/* locate BLIP of picture in Data stream at 
+ * sprmCPicLocation of current character - result is cached
+ * for each sprmCPicLocation */
+static int _inline_picture_locate(cfb_doc_t *doc, ldb_t *blip)
+{
+	FILE *Data = doc_data(doc);
+	if (!Data){
+		ERR("no Data stream");
+		return -1;
 	}
-	
-	fread(&t.tag, 1, 1, fp);
+	if (doc->prop.chp.sprmCFData){
+		/* TODO: NilPICFAndBinData */
+		return -1;
+	}
+
+	if (doc->reference)
+		return _inline_picture_parse(doc, Data, blip);
 
-	if (rh->recLen){
-		// read BLIP data
-		BYTE BLIPFileData[rh->recLen];
-		fread(&BLIPFileData, rh->recLen, 1, fp);
-		t.BLIPFileData = BLIPFileData;
+	LONG picLocation = doc->prop.chp.sprmCPicLocation;
+	
+	// position of picLocation in sorted cache
+	int lo = 0, hi = doc->npicfCache;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (doc->picfCache[mid].picLocation < picLocation)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < doc->npicfCache && 
+			doc->picfCache[lo].picLocation == picLocation)
+	{
+		*blip = doc->picfCache[lo].blip;
+		return doc->picfCache[lo].ret;
+	}
 
-		pic->type = pict_png;
-		pic->data = BLIPFileData;
-		pic->len  = rh->recLen;
+	int ret = _inline_picture_parse(doc, Data, blip);
 
-		if (callback)
-			callback(pic, userdata);
+	// insert to cache keeping it sorted
+	if (doc->npicfCache == doc->picfCacheCap){
+		int cap = doc->picfCacheCap ? doc->picfCacheCap * 2 : 16;
+		void *p = realloc(doc->picfCache, 
+				cap * sizeof(struct PicfCacheEntry));
+		if (!p){
+			ERR("realloc");
+			return ret;
+		}
+		doc->picfCache = p;
+		doc->picfCacheCap = cap;
 	}
-};
+	
+	int i = lo;
+	memmove(&doc->picfCache[i + 1], &doc->picfCache[i],
+			(doc->npicfCache - i) * sizeof(struct PicfCacheEntry));
+	doc->picfCache[i].picLocation = picLocation;
+	doc->picfCache[i].ret = ret;
+	doc->picfCache[i].blip = *blip;
+	doc->npicfCache++;
+	
+	return ret;
+}
 
-static void image_from_OfficeArtFBSE(
-		FILE *fp, 
-		cfb_doc_t *doc,
-		struct OfficeArtRecordHeader *rh, 
-		struct picture *pic,
-		void *userdata,
-		void (*callback)(struct picture *pic, void *userdata))
+/* locate BLIP of shape anchored at CP of current 
+ * character */
+static int _floating_picture_locate(cfb_doc_t *doc, ldb_t *blip)
 {
-	struct OfficeArtFBSE t;	
-	memset(&t, 0, sizeof(struct OfficeArtFBSE));
-
-	t.rh = *rh;
-	fread(&t.btWin32, 1, 1,  fp);
-	fread(&t.btMacOS, 1, 1,  fp);
-	fread(t.rgbUid,   1, 16, fp);
-	fread(&t.tag,     2, 1,  fp);
-	fread(&t.size,    4, 1,  fp);
-	fread(&t.cRef,    4, 1,  fp);
-	fread(&t.foDelay, 4, 1,  fp);
-	fread(&t.unused1, 1, 1,  fp);
-	fread(&t.cbName,  1, 1,  fp);
-	fread(&t.unused2, 1, 1,  fp);
-	fread(&t.unused3, 1, 1,  fp);
+	struct PlcfSpa *plcfspa = doc_plcfspa(doc);
+	if (!plcfspa){
+		ERR("no shapes in document");
+		return -1;
+	}
 
-	
-	t.nameData = NULL;
-	BYTE nameData[t.cbName + 1];
-	if (t.cbName){
-		fread(nameData, t.cbName, 1, fp);
-		t.nameData = nameData;
+	// find first shape anchored at CP - lower bound, so
+	// shapes with the same anchor resolve to the first one
+	CP cp = doc->prop.chp.cp;
+	int lo = 0, hi = doc->plcfspaNaCP;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (plcfspa->aCP[mid] < cp)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
-	
-	if (t.foDelay > 0){
-		// the image is in OfficeArtBStoreDelay
-		fp = doc->WordDocument;
-		fseek(fp, t.foDelay, SEEK_SET);
+	if (lo == doc->plcfspaNaCP || plcfspa->aCP[lo] != cp){
+		ERR("no floating picture for CP: %d", cp);
+		return -1;
 	}
-	
-	// read BLIP header
-	struct OfficeArtRecordHeader header;
-	fread(&header, OfficeArtRecordHeaderSize, 1, fp);
+	int index = lo;
 
-#ifdef DEBUG
-	LOG("BLIP with type: 0x%X and len %d",
-			header.recType, header.recLen);
-#endif
+	blip->pic.goalw  = 
+		plcfspa->aSpa[index].rca.right - 
+		plcfspa->aSpa[index].rca.left; 
 	
-	if (header.recType == OfficeArtRecTypeOfficeArtFBSE)
-		return image_from_OfficeArtFBSE(
-				fp, doc, &header, pic, userdata, callback);
+	blip->pic.goalh  = 
+		plcfspa->aSpa[index].rca.bottom - 
+		plcfspa->aSpa[index].rca.top; 
 
-	if (header.recType == OfficeArtRecTypeOfficeArtBlipEMF)
-		return image_from_OfficeArtBlipEMF(
-				fp, &header, pic, userdata, callback);
+	// get BLIP from OfficeArtBStoreContainer
+	struct DggInfo *dggInfo = doc_dgginfo(doc);
+	if (!dggInfo)
+		return -1;
 
-	if (header.recType == OfficeArtRecTypeOfficeArtBlipWMF)
-		return image_from_OfficeArtBlipWMF(
-				fp, &header, pic, userdata, callback);
+	if (index >= dggInfo->nrgfb || !dggInfo->rgfb[index].fp){
+		ERR("no BLIP for shape at CP: %d", doc->prop.chp.cp);
+		return -1;
+	}
+	struct BStoreEntry *e = &dggInfo->rgfb[index];
+
+	struct OfficeArtRecordHeader rh;
+	fseek(e->fp, e->off, SEEK_SET);
+	if (fread(&rh, OfficeArtRecordHeaderSize, 1,
+			e->fp) != 1)
+	{
+		ERR("fread");
+		return -1;
+	}
+
+	FILE *fp = _blip_from_OfficeArtFBSE(e->fp, doc, &rh);
+	if (!fp)
+		return -1;
 	
-	if (header.recType == OfficeArtRecTypeOfficeArtBlipPICT)
-		return image_from_OfficeArtBlipPICT(
-				fp, &header, pic, userdata, callback);
-
-	if (
-			header.recType == OfficeArtRecTypeOfficeArtBlipJPEG ||
-			header.recType == OfficeArtRecTypeOfficeArtBlipJPEG_
-			)
-		return image_from_OfficeArtBlipJPEG(
-				fp, &header, pic, userdata, callback);
+	return _blip_locate(fp, &rh, blip);
+}
+
+int doc_get_picture_view(int ch, ldp_t *p, ldb_t *blip)
+{
+	memset(blip, 0, sizeof(ldb_t));
 	
-	if (header.recType == OfficeArtRecTypeOfficeArtBlipPNG)
-		return image_from_OfficeArtBlipPNG(
-				fp, &header, pic, userdata, callback);
+	int ret;
+	if (ch == INLINE_PICTURE)
+		ret = _inline_picture_locate(p->data, blip);
+	else if (ch == FLOATING_PICTURE)
+		ret = _floating_picture_locate(p->data, blip);
+	else {
+		ERR("Not a picture CH: 0x%X", ch);
+		return -1;
+	}
 	
-	if (header.recType == OfficeArtRecTypeOfficeArtBlipDIB)
-		return image_from_OfficeArtBlipDIB(
-				fp, &header, pic, userdata, callback);
+	if (!ret)
+		DOC_PROBE3(picture__extract, p->data, blip->offset, 
+				blip->pic.len);
+	return ret;
+}
+
+/* read BLIPFileData by chunks and run sink for each */
+static int _blip_stream(
+		ldb_t *blip, size_t chunk, void *userdata,
+		int (*sink)(void *userdata, PICT *pic, 
+			const unsigned char *buf, size_t len))
+{
+	if (chunk == 0)
+		chunk = DOC_PICTURE_CHUNK;
+	if (chunk > (size_t)blip->pic.len)
+		chunk = blip->pic.len;
 	
-	if (header.recType == OfficeArtRecTypeOfficeArtBlipTIFF)
-		return image_from_OfficeArtBlipTIFF(
-				fp, &header, pic, userdata, callback);
+	unsigned char *buf = NULL;
+	if (chunk){
+		buf = malloc(chunk);
+		if (!buf){
+			ERR("malloc");
+			return DOC_ERR_ALLOC;
+		}
+	}
 
-};
+	int ret = DOC_NO_ERR;
+	size_t left = blip->pic.len;
+	fseek(blip->stream, blip->offset, SEEK_SET);
+	while (left > 0) {
+		size_t len = left < chunk ? left : chunk;
+		if (fread(buf, len, 1, blip->stream) != 1){
+			ERR("fread");
+			ret = DOC_ERR_FILE;
+			break;
+		}
+		if (sink(userdata, &blip->pic, buf, len)){
+			ret = DOC_CB_STOP;
+			break;
+		}
+		left -= len;
+	}
 
-void doc_get_inline_picture(
-		int ch, ldp_t *p, void *userdata,
-		void (*callback)(struct picture *pic, void *userdata))
+	free(buf);
+	return ret;
+}
+
+int doc_get_picture_stream(
+		int ch, ldp_t *p, size_t chunk, void *userdata,
+		int (*sink)(void *userdata, PICT *pic, 
+			const unsigned char *buf, size_t len))
 {
-	cfb_doc_t *doc = p->data;
-	if (ch == INLINE_PICTURE){
-		if (doc->prop.chp.sprmCFData){
-			/* TODO: NilPICFAndBinData */
-		
-		} else {
-			//PICFAndOfficeArtData
-			struct PICFAndOfficeArtData t;
-			memset(&t, 0, 
-					sizeof(struct PICFAndOfficeArtData));
-			
-			// read PICF from stream
-			fseek(doc->Data, 
-					doc->prop.chp.sprmCPicLocation,
-					SEEK_SET);
-			fread(&t, 68, 1, doc->Data);
-	
-			// read PicName if needed
-			if (t.picf.mfpf.mm == MM_SHAPEFILE){
-				fread(&t.cchPicName,
-						1, 1, doc->Data);
-				BYTE stPicName[t.cchPicName + 1];
-				t.stPicName = NULL;
-				if (t.cchPicName > 0){
-					fread(stPicName,
-							t.cchPicName, 1, doc->Data);
-					t.stPicName = stPicName; 
-				}
-			}
+	ldb_t blip;
+	if (doc_get_picture_view(ch, p, &blip))
+		return DOC_ERR_FILE;
 
-			// read SpContainer header
-			struct OfficeArtRecordHeader spHeader;
-			fread(&spHeader,
-					OfficeArtRecordHeaderSize,
-					1, doc->Data);
+	DOC_TRACE_BEGIN("picture", blip.offset);
+	int ret = _blip_stream(&blip, chunk, userdata, sink);
+	DOC_TRACE_END("picture", blip.offset);
+	return ret;
+}
 
-			if (spHeader.recType != 
-					OfficeArtRecTypeOfficeArtSpContainer)
+/* inflate DEFLATE compressed metafile BLIPFileData with 
+ * input and output windows of chunk bytes and run sink for
+ * each output window */
+static int _blip_inflate(
+		ldb_t *blip, size_t chunk, void *userdata,
+		int (*sink)(void *userdata, PICT *pic, 
+			const unsigned char *buf, size_t len))
+{
+#ifdef HAVE_LIBZ
+	if (chunk == 0)
+		chunk = DOC_PICTURE_CHUNK;
+
+	unsigned char *in = malloc(chunk);
+	unsigned char *out = malloc(chunk);
+	if (!in || !out){
+		ERR("malloc");
+		free(in);
+		free(out);
+		return DOC_ERR_ALLOC;
+	}
+
+	z_stream zs;
+	memset(&zs, 0, sizeof(z_stream));
+	if (inflateInit(&zs) != Z_OK){
+		ERR("inflateInit: %s", zs.msg ? zs.msg : "");
+		free(in);
+		free(out);
+		return DOC_ERR_ALLOC;
+	}
+
+	// BLIPFileData is compressed - sink gets uncompressed
+	// size
+	size_t left = blip->pic.len;
+	blip->pic.len = blip->cbSize;
+	
+	int ret = DOC_NO_ERR, zret = Z_OK;
+	fseek(blip->stream, blip->offset, SEEK_SET);
+	while (zret != Z_STREAM_END && left > 0) {
+		size_t len = left < chunk ? left : chunk;
+		if (fread(in, len, 1, blip->stream) != 1){
+			ERR("fread");
+			ret = DOC_ERR_FILE;
+			break;
+		}
+		left -= len;
+		
+		zs.next_in  = in;
+		zs.avail_in = len;
+		do {
+			zs.next_out  = out;
+			zs.avail_out = chunk;
+			zret = inflate(&zs, Z_NO_FLUSH);
+			if (zret != Z_OK && zret != Z_STREAM_END &&
+					zret != Z_BUF_ERROR)
 			{
-				ERR("This is not OfficeArtSpContainer");
-				return;
+				ERR("inflate: %s", zs.msg ? zs.msg : "");
+				ret = DOC_ERR_FILE;
+				break;
 			}
+			size_t have = chunk - zs.avail_out;
+			if (have && sink(userdata, &blip->pic, out, have)){
+				ret = DOC_CB_STOP;
+				break;
+			}
+		} while (zs.avail_out == 0 && zret != Z_STREAM_END);
+		
+		if (ret)
+			break;
+	}
 
-			// skip SpContainer shape data
-			fseek(doc->Data,
-					spHeader.recLen, SEEK_CUR);
-
-			// read OfficeArtBStoreContainerFileBlock header
-			struct OfficeArtRecordHeader rh;
-			fread(&rh,
-					OfficeArtRecordHeaderSize,
-					1, doc->Data);
+	if (!ret && zret != Z_STREAM_END){
+		ERR("compressed metafile is truncated");
+		ret = DOC_ERR_FILE;
+	}
 
-#ifdef DEBUG
-			LOG("OfficeArtBStoreContainerFileBlock with type: 0x%X and len %d",
-					rh.recType, rh.recLen);
+	inflateEnd(&zs);
+	free(in);
+	free(out);
+	return ret;
+#else
+	ERR("libdoc is built without zlib - can't inflate metafile");
+	return DOC_ERR_FILE;
 #endif
+}
 
-			struct picture pic;
-			memset(&pic, 0, sizeof(struct picture));
-			
-			pic.goalw  = t.picf.picmid.dxaGoal;
-			pic.goalh  = t.picf.picmid.dyaGoal;
-			pic.scalex = t.picf.picmid.mx;
-			pic.scaley = t.picf.picmid.my;
-
-			if (rh.recType == OfficeArtRecTypeOfficeArtFBSE)
-				return image_from_OfficeArtFBSE(
-						doc->Data, doc, &rh, &pic, userdata, callback);
-		
-			if (rh.recType == OfficeArtRecTypeOfficeArtBlipEMF)
-				return image_from_OfficeArtBlipEMF(
-						doc->Data, &rh, &pic, userdata, callback);
+int doc_get_picture_inflate(
+		int ch, ldp_t *p, size_t chunk, void *userdata,
+		int (*sink)(void *userdata, PICT *pic, 
+			const unsigned char *buf, size_t len))
+{
+	ldb_t blip;
+	if (doc_get_picture_view(ch, p, &blip))
+		return DOC_ERR_FILE;
 
-			if (rh.recType == OfficeArtRecTypeOfficeArtBlipWMF)
-				return image_from_OfficeArtBlipWMF(
-						doc->Data, &rh, &pic, userdata, callback);
-			
-			if (rh.recType == OfficeArtRecTypeOfficeArtBlipPICT)
-				return image_from_OfficeArtBlipPICT(
-						doc->Data, &rh, &pic, userdata, callback);
-			
-			if (
-					rh.recType == OfficeArtRecTypeOfficeArtBlipJPEG ||
-					rh.recType == OfficeArtRecTypeOfficeArtBlipJPEG_
-					)
-				return image_from_OfficeArtBlipJPEG(
-						doc->Data, &rh, &pic, userdata, callback);
-
-			if (rh.recType == OfficeArtRecTypeOfficeArtBlipPNG)
-				return image_from_OfficeArtBlipPNG(
-						doc->Data, &rh, &pic, userdata, callback);
-			
-			if (rh.recType == OfficeArtRecTypeOfficeArtBlipDIB)
-				return image_from_OfficeArtBlipDIB(
-						doc->Data, &rh, &pic, userdata, callback);
-			
-			if (rh.recType == OfficeArtRecTypeOfficeArtBlipTIFF)
-				return image_from_OfficeArtBlipDIB(
-						doc->Data, &rh, &pic, userdata, callback);
-		}	
+	int ret;
+	DOC_TRACE_BEGIN("picture", blip.offset);
+	if (!blip.compressed)
+		ret = _blip_stream(&blip, chunk, userdata, sink);
+	else
+		ret = _blip_inflate(&blip, chunk, userdata, sink);
+	DOC_TRACE_END("picture", blip.offset);
+	return ret;
+}
+
+int doc_get_picture_info(int ch, ldp_t *p, ldb_t *blip)
+{
+	if (doc_get_picture_view(ch, p, blip))
+		return -1;
+
+	_blip_sniff_size(blip);
+	return 0;
+}
+
+static int _picture_fd_sink(void *userdata, PICT *pic, 
+		const unsigned char *buf, size_t len)
+{
+	int fd = *(int *)userdata;
+	while (len > 0) {
+		ssize_t n = write(fd, buf, len);
+		if (n < 0){
+			if (errno == EINTR)
+				continue;
+			ERR("write: %s", strerror(errno));
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+int doc_get_picture_fd(int ch, ldp_t *p, int fd)
+{
+	return doc_get_picture_stream(
+			ch, p, 0, &fd, _picture_fd_sink);
+}
+
+/* read BLIPFileData to heap and run callback with picture */
+int doc_picture_read(
+		ldb_t *blip, void *userdata,
+		void (*callback)(struct picture *pic, void *userdata))
+{
+	if (blip->pic.len <= 0)
+		return DOC_ERR_FILE;
+
+	BYTE *BLIPFileData = malloc(blip->pic.len);
+	if (!BLIPFileData){
+		ERR("malloc");
+		return DOC_ERR_ALLOC;
 	}
+
+	DOC_TRACE_BEGIN("picture", blip->offset);
+	fseek(blip->stream, blip->offset, SEEK_SET);
+	if (fread(BLIPFileData, blip->pic.len, 1, 
+				blip->stream) != 1)
+	{
+		ERR("fread");
+		free(BLIPFileData);
+		DOC_TRACE_END("picture", blip->offset);
+		return DOC_ERR_FILE;
+	}
+
+	blip->pic.data = BLIPFileData;
+	if (callback)
+		callback(&blip->pic, userdata);
+	
+	blip->pic.data = NULL;
+	free(BLIPFileData);
+	DOC_TRACE_END("picture", blip->offset);
+	return 0;
+}
+
+void doc_get_inline_picture(
+		int ch, ldp_t *p, void *userdata,
+		void (*callback)(struct picture *pic, void *userdata))
+{
+	ldb_t blip;
+	if (ch == INLINE_PICTURE &&
+			!doc_get_picture_view(ch, p, &blip))
+		doc_picture_read(&blip, userdata, callback);
 }
+
 void doc_get_floating_picture(
 		int ch, ldp_t *p, void *userdata,
 		void (*callback)(struct picture *pic, void *userdata))
 {
-	cfb_doc_t *doc = p->data;
 	if (ch != FLOATING_PICTURE){
 		ERR("not a FLOATING_PICTURE");
 		return;
 	}
 
-	int i;
-	for (i = 0; i < doc->plcfspaNaCP; ++i) {
-		CP cp = doc->plcfspa->aCP[i];	
-		if (cp == doc->prop.chp.cp)
-			break;
-	}
-	int index = i;
+	ldb_t blip;
+	if (!doc_get_picture_view(ch, p, &blip))
+		doc_picture_read(&blip, userdata, callback);
+}
 
-	if (doc->plcfspa->aCP[index] != doc->prop.chp.cp){
-		ERR("no floating picture for CP: %d", doc->prop.chp.cp);
-		return;
-	}
+void doc_get_picture(
+		int ch, ldp_t *p, void *userdata,
+		void (*callback)(struct picture *pic, void *userdata))
+{
+	ldb_t blip;
+	if (!doc_get_picture_view(ch, p, &blip) &&
+			!doc_uid_seen(blip.uid) &&
+			!doc_picture_read(&blip, userdata, callback))
+		doc_uid_mark(blip.uid);
+}
 
-	struct picture pic;
-	memset(&pic, 0, sizeof(struct picture));
-			
-	pic.goalw  = 
-		doc->plcfspa->aSpa[index].rca.right - 
-		doc->plcfspa->aSpa[index].rca.left; 
-	
-	pic.goalh  = 
-		doc->plcfspa->aSpa[index].rca.bottom - 
-		doc->plcfspa->aSpa[index].rca.top; 
+/* picture locations found in CHPX - sprmCPicLocation and
+ * sprmCFData of one run */
+struct _piclocs {
+	LONG *a;
+	int n;
+	int cap;
+	LONG picLocation;
+	char fData;
+	char found;
+};
 
-	// get OfficeArtDggContainer
-	FibRgFcLcb97 *rgFcLcb97 = (FibRgFcLcb97 *)(doc->fib.rgFcLcb);
-	ULONG off = rgFcLcb97->fcDggInfo;
-	ULONG len = rgFcLcb97->lcbDggInfo;
+static int _piclocs_cb(void *userdata, struct Prl *prl)
+{
+	struct _piclocs *l = userdata;
+	if (SprmSgc(prl->sprm) != sgcCha)
+		return 0;
 
-	fseek(doc->Table, off, SEEK_SET);
-	
-	// read OfficeArtDggContainer header
-	struct OfficeArtRecordHeader rh;
-	fread(&rh, OfficeArtRecordHeaderSize, 1,
-			doc->Table);
-#ifdef DEBUG
-	LOG("OfficeArtDggContainer type: 0x%X, len: %d", rh.recType, rh.recLen);
-#endif
-	
-	if (rh.recType != OfficeArtRecTypeOfficeArtDggContainer)
-	{
-		ERR(" this is not OfficeArtDggContainer");
-		return;
-	}
-	// read OfficeArtFDGGBlock header
-	fread(&rh, OfficeArtRecordHeaderSize, 1,
-			doc->Table);
+	USHORT ismpd = SprmIspmd(prl->sprm);
+	if (ismpd == sprmCPicLocation){
+		memcpy(&l->picLocation, prl->operand, 4);
+		l->found = 1;
+	} else if (ismpd == sprmCFData)
+		l->fData = prl->operand[0];
 	
-#ifdef DEBUG
-	LOG("OfficeArtFDGGBlock type: 0x%X, len: %d", rh.recType, rh.recLen);
-#endif
+	return 0;
+}
 
-	if (rh.recType != OfficeArtRecTypeOfficeArtFDggBlock)
-	{
-		ERR(" this is not OfficeArtFDggBlock");
-		return;
-	}
-	// skip block
-	fseek(doc->Table, 
-			rh.recLen, SEEK_CUR);
+/* collect sprmCPicLocation of all CHPX in ChpxFkp pages 
+ * without text decoding */
+static int _piclocs_collect(cfb_doc_t *doc, struct _piclocs *l)
+{
+	struct PlcBteChpx *plcbteChpx = doc_plcbteChpx(doc);
+	if (!plcbteChpx)
+		return -1;
 
-	// read BLip Store
-	// read header OfficeArtBStoreContainer with index `i`
-	fread(&rh, OfficeArtRecordHeaderSize, 1,
-			doc->Table);
+	int i, j;
+	for (i = 0; i < doc->plcbteChpxNaFc - 1; ++i) {
+		ULONG chpxFkp_fc = pnFkpChpx_pn(
+				plcbteChpx->aPnBteChpx[i]) * 512;
 		
-#ifdef DEBUG
-	USHORT recInstance = OfficeArtRecordHeaderRecInstance(&rh);
-	LOG("OfficeArtBStoreContainer type: 0x%X, len: %d, number of records: %d", rh.recType, rh.recLen, recInstance);
-#endif
+		struct ChpxFkp chpxFkp;
+		BYTE buf[512];	
+		// crun stays 0 if page can not be read
+		memset(&chpxFkp, 0, sizeof(chpxFkp));
+		chpxFkp_init(&chpxFkp, buf, doc->WordDocument, 
+				chpxFkp_fc);
+		doc_budget_read(doc, 512);
+		if (doc_budget_step(doc))
+			return DOC_ERR_BUDGET;
+		
+		// crun is 0x01 - 0x65, rgb follows rgfc in page
+		if (chpxFkp.crun > 0x65)
+			continue;
+		
+		for (j = 0; j < chpxFkp.crun; ++j) {
+			// Chpx is at rgb[j] * 2 in page - 0 is no Chpx
+			int off = chpxFkp.rgb[j] * 2;
+			if (off == 0 || off >= 511)
+				continue;
+			
+			BYTE cb = buf[off];
+			if (off + 1 + cb > 511)
+				continue;
 
-	if (rh.recType != OfficeArtRecTypeOfficeArtBStoreContainer)
-	{
-		ERR(" this is not OfficeArtBStoreContainer");
-		return;
+			l->found = 0;
+			l->fData = 0;
+			parse_grpprl(&buf[off + 1], cb, l, _piclocs_cb);
+			
+			// NilPICFAndBinData is not a picture
+			if (!l->found || l->fData)
+				continue;
+
+			if (l->n == l->cap){
+				int cap = l->cap ? l->cap * 2 : 16;
+				void *a = realloc(l->a, cap * sizeof(LONG));
+				if (!a){
+					ERR("realloc");
+					return DOC_ERR_ALLOC;
+				}
+				l->a = a;
+				l->cap = cap;
+			}
+			l->a[l->n++] = l->picLocation;
+		}
 	}
-	// length od OfficeArtBStoreContainer
-	int lenOfficeArtBStoreContainer = rh.recLen;
 
-	// read rgfb header
-	fread(&rh, OfficeArtRecordHeaderSize, 1,
-			doc->Table);
+	return 0;
+}
+
+static int _long_compare(const void *a, const void *b)
+{
+	const LONG *x = a, *y = b;
+	return (*x > *y) - (*x < *y);
+}
+
+static int _blip_offset_compare(const void *a, const void *b)
+{
+	const ldb_t *x = a, *y = b;
+	if (x->stream != y->stream)
+		return (x->stream > y->stream) - (x->stream < y->stream);
+	return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+static int _blip_uid_compare(const void *a, const void *b)
+{
+	const ldb_t *x = a, *y = b;
+	int ret = memcmp(x->uid, y->uid, 16);
+	if (ret)
+		return ret;
+	return _blip_offset_compare(a, b);
+}
+
+int doc_extract_pictures(libdoc_t *doc, void *userdata,
+		int (*sink)(void *userdata, ldb_t *blip))
+{
+	int i, n = 0, ret = 0;
+	doc_budget_start(doc);
 	
-#ifdef DEBUG
-	LOG("OfficeArtBStoreContainerFileBlock with type: 0x%X and len %d",
-					rh.recType, rh.recLen);
-#endif
+	// pictures of OfficeArtBStoreContainer
+	struct DggInfo *dggInfo = doc_dgginfo(doc);
 	
-	// skip to index
-	i = 0;
-	while (lenOfficeArtBStoreContainer > 0)
-	{
-		if (i++ == index)
-			break;
-		fseek(doc->Table, rh.recLen, SEEK_CUR);
-		lenOfficeArtBStoreContainer -= rh.recLen;
-		fread(&rh, OfficeArtRecordHeaderSize, 1,
-				doc->Table);
+	// inline pictures in Data stream
+	struct _piclocs l;
+	memset(&l, 0, sizeof(struct _piclocs));
+	if (doc_data(doc)){
+		ret = _piclocs_collect(doc, &l);
+		if (ret){
+			free(l.a);
+			return ret;
+		}
+		// the same picture can be referenced by many runs
+		qsort(l.a, l.n, sizeof(LONG), _long_compare);
+		int k = 0;
+		for (i = 0; i < l.n; ++i)
+			if (k == 0 || l.a[k-1] != l.a[i])
+				l.a[k++] = l.a[i];
+		l.n = k;
+	}
+
+	int nblips = l.n + (dggInfo ? dggInfo->nrgfb : 0);
+	ldb_t *blips = NULL;
+	if (nblips){
+		blips = malloc(nblips * sizeof(ldb_t));
+		if (!blips){
+			ERR("malloc");
+			free(l.a);
+			return DOC_ERR_ALLOC;
+		}
 	}
 
-	if (rh.recType == OfficeArtRecTypeOfficeArtFBSE)
-		return image_from_OfficeArtFBSE(
-				doc->Table, doc, &rh, &pic, userdata, callback);
+	for (i = 0; dggInfo && i < dggInfo->nrgfb; ++i) {
+		struct BStoreEntry *e = &dggInfo->rgfb[i];
+		if (!e->fp)
+			continue;
+		
+		struct OfficeArtRecordHeader rh;
+		fseek(e->fp, e->off, SEEK_SET);
+		if (fread(&rh, OfficeArtRecordHeaderSize, 1,
+				e->fp) != 1)
+			continue;
+
+		memset(&blips[n], 0, sizeof(ldb_t));
+		FILE *fp = _blip_from_OfficeArtFBSE(e->fp, doc, &rh);
+		if (fp && !_blip_locate(fp, &rh, &blips[n]))
+			n++;
+	}
+
+	// _inline_picture_locate reads location from current 
+	// character properties
+	CHP chp = doc->prop.chp;
+	for (i = 0; i < l.n; ++i) {
+		doc->prop.chp.sprmCPicLocation = l.a[i];
+		doc->prop.chp.sprmCFData = 0;
+		memset(&blips[n], 0, sizeof(ldb_t));
+		if (!_inline_picture_locate(doc, &blips[n]))
+			n++;
+	}
+	doc->prop.chp = chp;
+	free(l.a);
+
+	// drop pictures with the same location or the same UID
+	qsort(blips, n, sizeof(ldb_t), _blip_uid_compare);
+	int k = 0;
+	static const BYTE nouid[16];
+	for (i = 0; i < n; ++i) {
+		if (k > 0 && 
+				!_blip_offset_compare(&blips[k-1], &blips[i]))
+			continue;
+		if (k > 0 && memcmp(blips[i].uid, nouid, 16) &&
+				!memcmp(blips[k-1].uid, blips[i].uid, 16))
+			continue;
+		blips[k++] = blips[i];
+	}
+	n = k;
+
+	// read in stream offset order
+	qsort(blips, n, sizeof(ldb_t), _blip_offset_compare);
+	for (i = 0; i < n; ++i) {
+		ldb_t *blip = &blips[i];
+		if (doc_uid_seen(blip->uid))
+			continue;
+		DOC_PROBE3(picture__extract, doc, blip->offset, 
+				blip->pic.len);
+		
+		if (doc_canceled(doc)){
+			ret = DOC_CANCEL;
+			break;
+		}
 
-	if (rh.recType == OfficeArtRecTypeOfficeArtBlipEMF)
-		return image_from_OfficeArtBlipEMF(
-				doc->Table, &rh, &pic, userdata, callback);
+		// charge picture before it is allocated
+		doc_budget_read(doc, blip->pic.len);
+		if (doc_budget_check(doc)){
+			ret = DOC_ERR_BUDGET;
+			break;
+		}
 
-	if (rh.recType == OfficeArtRecTypeOfficeArtBlipWMF)
-		return image_from_OfficeArtBlipWMF(
-				doc->Table, &rh, &pic, userdata, callback);
-	
-	if (rh.recType == OfficeArtRecTypeOfficeArtBlipPICT)
-		return image_from_OfficeArtBlipPICT(
-				doc->Table, &rh, &pic, userdata, callback);
-	
-	if (
-			rh.recType == OfficeArtRecTypeOfficeArtBlipJPEG ||
-			rh.recType == OfficeArtRecTypeOfficeArtBlipJPEG_
-			)
-		return image_from_OfficeArtBlipJPEG(
-				doc->Table, &rh, &pic, userdata, callback);
-
-	if (rh.recType == OfficeArtRecTypeOfficeArtBlipPNG)
-		return image_from_OfficeArtBlipPNG(
-				doc->Table, &rh, &pic, userdata, callback);
-	
-	if (rh.recType == OfficeArtRecTypeOfficeArtBlipDIB)
-		return image_from_OfficeArtBlipDIB(
-				doc->Table, &rh, &pic, userdata, callback);
-	
-	if (rh.recType == OfficeArtRecTypeOfficeArtBlipTIFF)
-		return image_from_OfficeArtBlipDIB(
-				doc->Table, &rh, &pic, userdata, callback);
-}
+		BYTE *data = NULL;
+		if (blip->pic.len > 0){
+			data = malloc(blip->pic.len);
+			if (!data){
+				ERR("malloc");
+				ret = DOC_ERR_ALLOC;
+				break;
+			}
+			DOC_TRACE_BEGIN("picture", blip->offset);
+			fseek(blip->stream, blip->offset, SEEK_SET);
+			if (fread(data, blip->pic.len, 1, 
+						blip->stream) != 1)
+			{
+				ERR("fread");
+				free(data);
+				DOC_TRACE_END("picture", blip->offset);
+				continue;
+			}
+			DOC_TRACE_END("picture", blip->offset);
+		}
+		
+		blip->pic.data = data;
+		int stop = sink(userdata, blip);
+		blip->pic.data = NULL;
+		free(data);
+		// picture is passed - skip it in other documents
+		doc_uid_mark(blip->uid);
+		
+		if (stop){
+			ret = DOC_CB_STOP;
+			break;
+		}
+	}
 
-void doc_get_picture(
-		int ch, ldp_t *p, void *userdata,
-		void (*callback)(struct picture *pic, void *userdata))
-{
-	if (ch == INLINE_PICTURE)
-		return doc_get_inline_picture(ch, p, userdata, callback);
-	else if (ch == FLOATING_PICTURE)
-		return doc_get_floating_picture(ch, p, userdata, callback);
-	else 
-		ERR("Not a picture CH: 0x%X", ch);
+	free(blips);
+	return ret;
 }
 
 struct PlcBteChpx * plcbteChpx_get(
@@ -1681,7 +2656,7 @@ struct LPStd *LPStd_at_index(
 		// read cbStd
 		cbStd = *(SHORT *)&(rglpstd[i]);
 #ifdef DEBUG
-	LOG("SDT at index %d size: %d", k, *cbStd);
+	LOG("SDT at index %d size: %d", k, cbStd);
 #endif
 	if (cbStd < 0){
 		ERR("STSH corrupted, LPStd at index: %d, cbStd: %d", k, cbStd);
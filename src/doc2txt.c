@@ -2,11 +2,12 @@
  * File              : doc2txt.c
  * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
  * Date              : 27.05.2024
- * Last Modified Date: 07.08.2024
+ * Last Modified Date: 18.10.2026
  * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "../include/libdoc.h"
 #include "../ms-cfb/log.h"
 
@@ -15,19 +16,73 @@
 int styles(void *, STYLE *s);
 int text(void *, DOC_PART,  ldp_t*, int);
 
+static void print_stats(){
+	lds_t s;
+	doc_get_stats(NULL, &s);
+	fprintf(stderr, 
+			"chars: %lu\n"
+			"piece lookups: %lu\n"
+			"fkp reads: %lu\n"
+			"fkp hits: %lu\n"
+			"sprms: %lu\n"
+			"sprms unknown: %lu\n"
+			"styles: %lu\n"
+			"bytes: %lu\n"
+			"seeks: %lu\n"
+			"time read: %.6f\n"
+			"time styles: %.6f\n"
+			"time text: %.6f\n",
+			s.chars, s.pieces, s.fkpReads, s.fkpHits,
+			s.sprms, s.sprmsUnknown, s.styles,
+			s.bytes, s.seeks,
+			s.tRead, s.tStyles, s.tParts[MAIN_DOCUMENT]);
+}
+
 int main(int argc, char *argv[])
 {
+	const char *prog = argv[0];
+	int stats = 0;
+	const char *trace = NULL;
+	while (argc > 2){
+		if (strcmp(argv[1], "--stats") == 0){
+			stats = 1;
+			argv++; argc--;
+		} else if (argc > 3 && strcmp(argv[1], "--trace") == 0){
+			trace = argv[2];
+			argv += 2; argc -= 2;
+		} else
+			break;
+	}
+
 	if (argc != 2) {
-		printf("Usage: %s file.doc\n\n", argv[0]);
+		printf("Usage: %s [--stats] [--trace trace.json] file.doc\n\n", 
+				prog);
 		return 0;
 	}	
 
+	if (trace)
+		doc_trace_start(1 << 20);
+
 	int ret = doc_parse(
 			argv[1], 
 			NULL, 
 			styles,
 			text);
 
+	if (stats)
+		print_stats();
+
+	if (trace){
+		doc_trace_stop();
+		FILE *fp = fopen(trace, "w");
+		if (fp){
+			doc_trace_write(fp);
+			fclose(fp);
+		} else
+			perror(trace);
+		doc_trace_start(0);
+	}
+
 	return ret;
 }
 
@@ -2,7 +2,7 @@
  * File              : doc_parse.c
  * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
  * Date              : 26.05.2024
- * Last Modified Date: 07.08.2024
+ * Last Modified Date: 18.10.2026
  * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
  */
 #include "../include/libdoc.h"
@@ -20,14 +20,37 @@ int callback(void *d, struct Prl *prl){
 	return 0;
 }
 
+/* report progress and check cancel flag - called at 
+ * paragraph boundaries only. Return non-zero to stop */
+static int _progress(cfb_doc_t *doc, CP first, CP cp)
+{
+	unsigned long n = cp - first;
+	__atomic_store_n(&doc->progress, n, __ATOMIC_RELAXED);
+	
+	if (doc->progressCb && 
+			doc->progressCb(doc->progressData, n, doc->progressTotal))
+		doc_cancel(doc);
+
+	if (doc_canceled(doc)){
+		doc->stop = DOC_CANCEL;
+		return 1;
+	}
+	return 0;
+}
+
 CP parse_range_cp(cfb_doc_t *doc, CP cp, CP lcp,
 		void *user_data,
 		DOC_PART part,
 		int (*callback)(void *user_data, DOC_PART part, ldp_t *p, int ch))
 {
 	while (cp <= lcp && cp < doc->fib.rgLw97->ccpText){
-		get_char_for_cp(doc, cp, user_data, part,
-				callback);
+		DOC_PROBE2(callback__invoke, doc, cp);
+		if (get_char_for_cp(doc, cp, user_data, part,
+				callback))
+		{
+			doc->stop = DOC_CB_STOP;
+			return cp + 1;
+		}
 		cp++;
 	}
 	return cp;
@@ -38,29 +61,44 @@ CP parse_table_row(cfb_doc_t *doc, CP cp, CP lcp,
 		DOC_PART part,
 		int (*callback)(void *user_data, DOC_PART part, ldp_t *p, int ch))
 {
-	while (cp <= lcp && cp < doc->fib.rgLw97->ccpText){
+	while (cp <= lcp && cp < doc->fib.rgLw97->ccpText && 
+			!doc->stop)
+	{
 		//get cell
 		CP clcp = last_cp_in_row(doc, cp);
 		if (clcp == CPERROR)
 			return cp;
+		if (clcp > lcp || clcp < cp)
+			clcp = lcp;
 		
 		// parse cell
-		while (cp <= clcp && cp < doc->fib.rgLw97->ccpText){
-
+		while (cp <= clcp && cp < doc->fib.rgLw97->ccpText && 
+				!doc->stop)
+		{
 			// parse paragraph
-			CP lcp = last_cp_in_paragraph(doc, cp); 
-			cp = parse_range_cp(doc, cp, lcp, user_data, part, 
+			CP plcp = last_cp_in_paragraph(doc, cp); 
+			if (doc->stop)
+				return cp;
+			if (plcp > clcp || plcp < cp)
+				plcp = clcp;
+			DOC_PROBE3(paragraph__start, doc, cp, plcp);
+			cp = parse_range_cp(doc, cp, plcp, user_data, part, 
 					callback);
+			DOC_PROBE2(paragraph__end, doc, cp);
 		}
 	}
 	return cp;
 }
 
-static void _parse_styles(cfb_doc_t *doc, void *user_data, 
+static int _parse_styles(cfb_doc_t *doc, void *user_data, 
 		int (*styles)(void *user_data, STYLE *s))
 {
+	struct STSH *STSH = doc_stsh(doc);
+	if (!STSH)
+		return DOC_ERR_FILE;
+
 	// parse styles
-	USHORT cstd = doc->STSH.lpstshi->stshi->stshif.cstd;
+	USHORT cstd = STSH->lpstshi->stshi->stshif.cstd;
 #ifdef DEBUG
 	LOG("cstd: %d", cstd);
 #endif
@@ -69,9 +107,12 @@ static void _parse_styles(cfb_doc_t *doc, void *user_data,
 	for (i = 0; index < cstd;) {
 		// clean prop
 		memset(&doc->prop, 0, sizeof(ldp_t));
+		doc->prop.data = doc;
 
 		struct LPStd *LPStd = 
 			apply_style_properties(doc, index);
+		if (doc->budget.exceeded)
+			return DOC_ERR_BUDGET;
 				
 		if (!LPStd){
 			index++;
@@ -89,7 +130,6 @@ static void _parse_styles(cfb_doc_t *doc, void *user_data,
 		USHORT *p = NULL;
 
 		// check if STD->Stdf has StdfPost2000;
-		struct STSH *STSH = &doc->STSH;
 		struct STSHI *STSHI = STSH->lpstshi->stshi;
 		USHORT cbSTDBaseInFile = STSHI->stshif.cbSTDBaseInFile;
 		
@@ -127,39 +167,47 @@ static void _parse_styles(cfb_doc_t *doc, void *user_data,
 		s.sbedeon = istdBase;
 
 		// callback
-		styles(user_data, &s);
+		if (styles(user_data, &s))
+			return DOC_CB_STOP;
 
 		// iterate
 		index++;
 	}
+	return 0;
 }
 
-int doc_parse(const char *filename, void *user_data,
-		int (*styles)(void *user_data, STYLE *s),
+int doc_parse_styles(libdoc_t *doc, void *user_data,
+		int (*styles)(void *user_data, STYLE *s))
+{
+	double t = doc_clock();
+	doc_budget_start(doc);
+	// styles are resolved even for text-only document
+	int textOnly = doc->textOnly;
+	doc->textOnly = 0;
+	DOC_TRACE_BEGIN("_parse_styles", 0);
+	int ret = _parse_styles(doc, user_data, styles);
+	DOC_TRACE_END("_parse_styles", ret);
+	doc->textOnly = textOnly;
+	doc->stats.tStyles += doc_clock() - t;
+	return ret;
+}
+
+static int _parse_text(libdoc_t *doc, 
+		unsigned long first, unsigned long last,
+		void *user_data,
 		int (*text)(void *user_data, DOC_PART part, ldp_t *p, int ch))
 {
 #ifdef DEBUG
 	LOG("start");
 #endif
-	int ret, cp, i;
+	int i;
+	CP cp;
 
-	// get CFB
-	struct cfb cfb;
-	ret = cfb_open(&cfb, filename);
-	if (ret)
-		return ret;
-	
-	// Read the DOC Streams
-	cfb_doc_t doc;
-	ret = doc_read(&doc, &cfb);
-	if (ret)
-		return ret;
-
-	doc.prop.data = &doc;
-	FibRgFcLcb97 *rgFcLcb97 = (FibRgFcLcb97 *)(doc.fib.rgFcLcb);
-
-	// parse styles
-	_parse_styles(&doc, user_data, styles);
+	// load structures needed to walk the text
+	struct PlcfSed *plcfSed = doc_plcfSed(doc);
+	if (!doc_plcpcd(doc) || !doc_plcbtePapx(doc) || 
+			!doc_plcbteChpx(doc) || !plcfSed)
+		return DOC_ERR_FILE;
 
 /* 2.3.1 Main Document
  * The main document contains all content outside any of 
@@ -170,40 +218,156 @@ int doc_parse(const char *filename, void *user_data,
  * FibRgLw97.ccpText characters long.
  * The last character in the main document MUST be a 
  * paragraph mark (Unicode 0x000D).*/
+	if (last > doc->fib.rgLw97->ccpText)
+		last = doc->fib.rgLw97->ccpText;
 
-	// for each section in word document
-	for (i=0; i < doc.plcfSedNaCP; ++i){
-		CP first = doc.plcfSed->aCP[i];
-		CP last;
-		if (i < doc.plcfSedNaCP)
-			last = doc.plcfSed->aCP[i+1];
-		else
-			last = doc.fib.rgLw97->ccpText;
+	// preview - every CP of range is passed to callback, so
+	// limit range instead of counting characters
+	if (doc->max_chars && first < last && 
+			last - first > doc->max_chars)
+		last = first + doc->max_chars;
+
+	doc_budget_start(doc);
+	doc->stop = 0;
+	__atomic_store_n(&doc->progressTotal, 
+			first < last ? last - first : 0, __ATOMIC_RELAXED);
+	if (_progress(doc, first, first))
+		return doc->stop;
+
+	// for each section in range - PlcfSed has one more CP
+	// than sections
+	for (i=0; i < doc->plcfSedNaCP - 1; ++i){
+		CP sfirst = plcfSed->aCP[i];
+		CP slast  = plcfSed->aCP[i+1];
+		
+		if (slast <= first)
+			continue;
+		if (sfirst >= last || doc->stop)
+			break;
 		
 		// apply section prop
-		direct_section_formatting(&doc, i);
+		direct_section_formatting(doc, i);
 		
 		// parse section
-		for (cp = first; cp < last; ) {
-			
+		cp = sfirst > first ? sfirst : first;
+		DOC_PROBE3(section__start, doc, i, cp);
+		DOC_TRACE_BEGIN("section", i);
+		while (cp < slast && cp < last && 
+				!doc_budget_step(doc) && !doc->stop &&
+				!_progress(doc, first, cp)) 
+		{
 			// get table row and cell boundaries and apply props
-			CP lcp = last_cp_in_row(&doc, cp);
+			CP lcp = last_cp_in_row(doc, cp);
+			if (doc->stop)
+				break;
 			if (lcp != CPERROR){
 				// this CP is in table
-				cp = parse_table_row(&doc, cp, lcp, user_data, MAIN_DOCUMENT, 
+				if (lcp >= last || lcp < cp)
+					lcp = last - 1;
+				DOC_TRACE_BEGIN("table row", cp);
+				cp = parse_table_row(doc, cp, lcp, user_data, MAIN_DOCUMENT, 
 						text);
+				DOC_TRACE_END("table row", cp);
 
 			} else {
 				// get paragraph boundaries and apply props
-				CP lcp = last_cp_in_paragraph(&doc, cp); 
+				lcp = last_cp_in_paragraph(doc, cp); 
+				if (doc->stop)
+					break;
+				if (lcp >= last || lcp < cp)
+					lcp = last - 1;
 				
 				// iterate cp
-				cp = parse_range_cp(&doc, cp, lcp, user_data, MAIN_DOCUMENT, 
+				DOC_PROBE3(paragraph__start, doc, cp, lcp);
+				cp = parse_range_cp(doc, cp, lcp, user_data, MAIN_DOCUMENT, 
 						text);
+				DOC_PROBE2(paragraph__end, doc, cp);
 			}
 		}	
+		DOC_TRACE_END("section", i);
 	}
 
+	if (!doc->stop && first < last)
+		_progress(doc, first, last);
+
+#ifdef DEBUG
+	LOG("done");
+#endif
+	return doc->stop;
+}
+
+int doc_parse_text(libdoc_t *doc, 
+		unsigned long first, unsigned long last,
+		void *user_data,
+		int (*text)(void *user_data, DOC_PART part, ldp_t *p, int ch))
+{
+	double t = doc_clock();
+	int ret = _parse_text(doc, first, last, user_data, text);
+	doc->stats.tParts[MAIN_DOCUMENT] += doc_clock() - t;
+	return ret;
+}
+
+static int _picture_ch(void *user_data, DOC_PART part, ldp_t *p, int ch)
+{
+	int *c = user_data;
+	if (*c == -1)
+		*c = ch;
+	return 0;
+}
+
+int doc_get_picture_at_cp(
+		libdoc_t *doc, unsigned long cp, void *userdata,
+		void (*callback)(struct picture *pic, void *userdata))
+{
+	if (cp >= doc->fib.rgLw97->ccpText)
+		return DOC_ERR_FILE;
+
+	if (!doc_plcpcd(doc) || !doc_plcbteChpx(doc))
+		return DOC_ERR_FILE;
+
+	// get character and it's properties
+	int ch = -1;
+	get_char_for_cp(doc, cp, &ch, MAIN_DOCUMENT, 
+			_picture_ch);
+
+	if (ch != INLINE_PICTURE && ch != FLOATING_PICTURE)
+		return DOC_ERR_FILE;
+
+	// picture is delivered even if uid is already seen
+	ldb_t blip;
+	int ret = doc_get_picture_view(ch, &doc->prop, &blip);
+	if (ret)
+		return ret;
+	return doc_picture_read(&blip, userdata, callback);
+}
+
+int doc_parse(const char *filename, void *user_data,
+		int (*styles)(void *user_data, STYLE *s),
+		int (*text)(void *user_data, DOC_PART part, ldp_t *p, int ch))
+{
+#ifdef DEBUG
+	LOG("start");
+#endif
+	int ret;
+
+	// open document
+	libdoc_t *doc = doc_open(filename, &ret);
+	if (!doc)
+		return ret;
+	
+	// parse styles
+	if (styles){
+		ret = doc_parse_styles(doc, user_data, styles);
+		if (ret){
+			doc_close(doc);
+			return ret;
+		}
+	}
+
+	// parse main document
+	ret = doc_parse_text(doc, 0, doc->fib.rgLw97->ccpText, 
+			user_data, text);
+
 /* 2.3.2 Footnotes
  * The footnote document contains all of the content in the
  * footnotes. It begins at the CP immediately
@@ -247,10 +411,10 @@ int doc_parse(const char *filename, void *user_data,
 			/*HEADERS, text);*/
 /*}*/
 
-doc_close(&doc);
+	doc_close(doc);
 
 #ifdef DEBUG
 	LOG("done");
 #endif
-	return 0;
+	return ret;
 }
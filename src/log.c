@@ -0,0 +1,89 @@
+/**
+ * File              : log.c
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+#include "../include/libdoc/doc.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+#ifdef DEBUG
+int doc_log_level = DOC_LOG_DEBUG;
+#else
+int doc_log_level = DOC_LOG_ERR;
+#endif
+
+static struct {
+	void *userdata;
+	void (*sink)(void *userdata, int level, const char *msg);
+} _log;
+
+/* sites with messages - sites are added once and never
+ * removed */
+static struct doc_log_site *_sites;
+
+void doc_set_log(int level, void *userdata,
+		void (*sink)(void *userdata, int level, const char *msg))
+{
+	_log.userdata = userdata;
+	_log.sink = sink;
+	doc_log_level = level;
+}
+
+void doc_log_counters(void *userdata,
+		void (*callback)(void *userdata, int level,
+			const char *file, int line, const char *func,
+			unsigned long count))
+{
+	struct doc_log_site *site =
+		__atomic_load_n(&_sites, __ATOMIC_ACQUIRE);
+	for (; site; site = site->next)
+		callback(userdata, site->level, site->file, site->line,
+				site->func,
+				__atomic_load_n(&site->count, __ATOMIC_RELAXED));
+}
+
+void doc_log(struct doc_log_site *site, const char *fmt, ...)
+{
+	unsigned long n =
+		__atomic_add_fetch(&site->count, 1, __ATOMIC_RELAXED);
+
+	if (n == 1){
+		// first message of site - add it to list
+		struct doc_log_site *head =
+			__atomic_load_n(&_sites, __ATOMIC_RELAXED);
+		do {
+			site->next = head;
+		} while (!__atomic_compare_exchange_n(
+					&_sites, &head, site, 1,
+					__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	}
+
+	// first DOC_LOG_BURST messages of site, then when
+	// number of messages is power of 2
+	if (n > DOC_LOG_BURST && (n & (n - 1)))
+		return;
+
+	char msg[BUFSIZ];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, args);
+	va_end(args);
+
+	if (_log.sink){
+		_log.sink(_log.userdata, site->level, msg);
+		return;
+	}
+
+	if (n > DOC_LOG_BURST)
+		fprintf(stderr, "%s: %s: %d: %s (%lu times)\n",
+				site->level == DOC_LOG_ERR ? "E" : "D",
+				site->func, site->line, msg, n);
+	else
+		fprintf(stderr, "%s: %s: %d: %s\n",
+				site->level == DOC_LOG_ERR ? "E" : "D",
+				site->func, site->line, msg);
+}
@@ -2,7 +2,7 @@
  * File              : paragraph_boundaries.c
  * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
  * Date              : 26.05.2024
- * Last Modified Date: 07.08.2024
+ * Last Modified Date: 18.10.2026
  * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
  */
 
@@ -38,14 +38,19 @@ CP first_cp_in_paragraph(cfb_doc_t *doc, CP cp)
  * Text. If the algorithm from Retrieving Text specifies 
  * that cp is invalid, leave the algorithm. */
 	FibRgFcLcb97 *fibRgFcLcb97 = (FibRgFcLcb97 *)(doc->fib.rgFcLcb);
-	struct PlcPcd *plcPcd = &(doc->clx.Pcdt->PlcPcd);
+	struct PlcPcd *plcPcd = doc_plcpcd(doc);
+	struct PlcBtePapx *plcbtePapx = doc_plcbtePapx(doc);
+	if (!plcPcd || !plcbtePapx)
+		return CPERROR;
 
-	int i = 0;
-		while (plcPcd->aCp[i] <= cp)
-			i++;
-		i--;	
+	int i = plc_search(plcPcd->aCp, plcPcd->aCPl, cp);
 
   while(1){
+		// malformed PlcPcd or too much work
+		if (i < 0 || i + 1 >= plcPcd->aCPl || 
+				doc_budget_step(doc))
+			return CPERROR;
+
 /* 2. Let pcd be PlcPcd.aPcd[i]. */
 		pcd = &(plcPcd->aPcd[i]);
 
@@ -65,7 +70,7 @@ CP first_cp_in_paragraph(cfb_doc_t *doc, CP cp)
  * Let fcLast be the last element of plcbtePapx.aFc. */
 	 
 		ULONG fcLast = 
-			doc->plcbtePapx->aFc[doc->plcbtePapxNaFc-1];
+			plcbtePapx->aFc[doc->plcbtePapxNaFc-1];
 		ULONG fcFirst;
 
 /* If fcLast is less than or equal to fc, examine fcPcd. 
@@ -89,31 +94,40 @@ CP first_cp_in_paragraph(cfb_doc_t *doc, CP cp)
 /* 5. Find the largest j such that plcbtePapx.aFc[j] ≤ fc.
  * Read a PapxFkp at offset
  * aPnBtePapx[j].pn *512 in the WordDocument Stream. */
-		int j;
-		for (j=0; doc->plcbtePapx->aFc[j] <= fc; )
-			j++;	
-		j--;
+		int j = plc_search(plcbtePapx->aFc, 
+				doc->plcbtePapxNaFc, fc);
+		if (j < 0 || j + 1 >= doc->plcbtePapxNaFc)
+			return CPERROR;
 
 		of = pnFkpPapx_pn(
-					doc->plcbtePapx->aPnBtePapx[j]) * 512;
-		BYTE buf[512];
-		papxFkp_init(&papxFkp, buf, doc->WordDocument, of);
+					plcbtePapx->aPnBtePapx[j]) * 512;
+		BYTE *buf = doc_fkp_page(doc, &doc->papxCache, of);
+		if (!buf)
+			return CPERROR;
+		papxFkp_set(&papxFkp, buf);
 
 /* 6. Find the largest k such that PapxFkp.rgfc[k] ≤ fc.
  * If the last element of PapxFkp.rgfc is less
  * than or equal to fc, then cp is outside the range of
  * character positions in this document, and is
  * not valid. Let fcFirst be PapxFkp.rgfc[k].*/
-		for (k=0; papxFkp.rgfc[k] <= fc; )
-			k++;	
-		k--;
-		
+		// cpara is 0x01 - 0x1D, rgbx follows rgfc in page
+		if (papxFkp.cpara == 0 || papxFkp.cpara > 0x1D){
+			ERR("PapxFkp.cpara is out of range: %d", papxFkp.cpara);
+			return CPERROR;
+		}
 		if (papxFkp.rgfc[papxFkp.cpara] <= fc){
 			ERR("last element of PapxFkp.rgfc is less"
 					" than or equal to fc: cp is outside the"
 					" range of character positions in this document");
 			return CPERROR;
 		}
+
+		for (k=0; k < papxFkp.cpara && papxFkp.rgfc[k] <= fc; )
+			k++;	
+		k--;
+		if (k < 0)
+			return CPERROR;
 		fcFirst = papxFkp.rgfc[k];
 
 first_cp_in_paragraph_7:
@@ -161,6 +175,7 @@ CP last_cp_in_paragraph(cfb_doc_t *doc, CP cp)
 #endif
 	CP lcp = CPERROR;
 	struct PapxFkp papxFkp;
+	BYTE *buf;
 	struct Pcd *pcd = NULL;
 	int k=0;
 	ULONG of=0;
@@ -172,14 +187,19 @@ CP last_cp_in_paragraph(cfb_doc_t *doc, CP cp)
  * Text specifies that cp is invalid, leave the algorithm.
  */
 	FibRgFcLcb97 *fibRgFcLcb97 = (FibRgFcLcb97 *)(doc->fib.rgFcLcb);
-	struct PlcPcd *plcPcd = &(doc->clx.Pcdt->PlcPcd);
+	struct PlcPcd *plcPcd = doc_plcpcd(doc);
+	struct PlcBtePapx *plcbtePapx = doc_plcbtePapx(doc);
+	if (!plcPcd || !plcbtePapx)
+		return CPERROR;
 	
-	int i;
-	for(i=0; plcPcd->aCp[i] <= cp;)
-		i++;
-	i--;	
+	int i = plc_search(plcPcd->aCp, plcPcd->aCPl, cp);
 
 	while(1){
+		// malformed PlcPcd or too much work
+		if (i < 0 || i + 1 >= plcPcd->aCPl || 
+				doc_budget_step(doc))
+			return CPERROR;
+
 /* 2. Let pcd be PlcPcd.aPcd[i]. */
 		pcd = &(plcPcd->aPcd[i]);
 
@@ -207,36 +227,45 @@ CP last_cp_in_paragraph(cfb_doc_t *doc, CP cp)
  * fc, then go to step 7. Read a PapxFkp at
  * offset aPnBtePapx[j].pn *512 in the WordDocument Stream */
 		
-		int j;
-		for (j=0; doc->plcbtePapx->aFc[j] <= fc; )
-			j++;	
-		j--;
-		
-		if (doc->plcbtePapx->aFc[doc->plcbtePapxNaFc-1] <= fc){
+		if (plcbtePapx->aFc[doc->plcbtePapxNaFc-1] <= fc){
 			// goto 7
 			goto last_cp_in_paragraph_7;
 		}
 		
+		int j = plc_search(plcbtePapx->aFc, 
+				doc->plcbtePapxNaFc, fc);
+		if (j < 0)
+			return CPERROR;
+		
 		of = pnFkpPapx_pn(
-						doc->plcbtePapx->aPnBtePapx[j]) * 512;
-		BYTE buf[512];
-		papxFkp_init(&papxFkp, buf, doc->WordDocument, of);
+						plcbtePapx->aPnBtePapx[j]) * 512;
+		buf = doc_fkp_page(doc, &doc->papxCache, of);
+		if (!buf)
+			return CPERROR;
+		papxFkp_set(&papxFkp, buf);
 
 /* 5. Find largest k such that PapxFkp.rgfc[k] ≤ fc. If the
  * last element of PapxFkp.rgfc is less than
  * or equal to fc, then cp is outside the range of character
  * positions in this document, and is not
  * valid. Let fcLim be PapxFkp.rgfc[k+1]. */
-		for (k=0; papxFkp.rgfc[k] <= fc; )
-			k++;	
-		k--;
-		
+		// cpara is 0x01 - 0x1D, rgbx follows rgfc in page
+		if (papxFkp.cpara == 0 || papxFkp.cpara > 0x1D){
+			ERR("PapxFkp.cpara is out of range: %d", papxFkp.cpara);
+			return CPERROR;
+		}
 		if (papxFkp.rgfc[papxFkp.cpara] <= fc){
 			ERR("last element of PapxFkp.rgfc is less"
 					" than or equal to fc: cp is outside the"
 					" range of character positions in this document");
 			return CPERROR;
 		}
+
+		for (k=0; k < papxFkp.cpara && papxFkp.rgfc[k] <= fc; )
+			k++;	
+		k--;
+		if (k < 0)
+			return CPERROR;
 		ULONG fcLim = papxFkp.rgfc[k+1];
 		
 /* 6. If fcLim ≤ fcMac, then let dfc be (fcLim – fcPcd). If
@@ -246,11 +275,10 @@ CP last_cp_in_paragraph(cfb_doc_t *doc, CP cp)
  * Leave the algorithm. */
 		if (fcLim <= fcMac){
 			ULONG dfc = fcLim - fcPcd;
-			if (!FcCompressed(pcd->fc)){
+			if (!FcCompressed(pcd->fc))
 				dfc /= 2;
-				lcp = plcPcd->aCp[i] + dfc - 1;
-				break;
-			}
+			lcp = plcPcd->aCp[i] + dfc - 1;
+			break;
 		}
 /* 7. Set cp to PlcPcd.aCp[i+1]. Set i to i + 1. 
  * Go to step 2.*/
@@ -2,7 +2,7 @@
  * File              : retrieving_text.c
  * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
  * Date              : 26.05.2024
- * Last Modified Date: 06.08.2024
+ * Last Modified Date: 18.10.2026
  * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
  */
 #include "../include/libdoc/retrieving_text.h"
@@ -19,14 +19,25 @@ static void check_marks(cfb_doc_t *doc, int ch)
 	}
 }
 
-void get_char_for_cp(cfb_doc_t *doc, CP cp,
+/* pass character to text callback and count it */
+static int _emit(cfb_doc_t *doc, void *user_data, DOC_PART part,
+		int (*callback)(void *user_data, DOC_PART part, ldp_t *p, int ch),
+		int ch)
+{
+	doc->stats.chars++;
+	return callback(user_data, part, &doc->prop, ch);
+}
+
+int get_char_for_cp(cfb_doc_t *doc, CP cp,
 		void *user_data,
 		DOC_PART part,
 		int (*callback)(void *user_data, DOC_PART part, ldp_t *p, int ch)		
 		)
 {
-	struct PlcPcd *PlcPcd = &(doc->clx.Pcdt->PlcPcd);
+	struct PlcPcd *PlcPcd = doc_plcpcd(doc);
 	DWORD off; // ofset of WordDocument where text is located
+	if (!PlcPcd)
+		return 0;
 
 /* The Clx contains a Pcdt, and the Pcdt contains a PlcPcd.
  * Find the largest i such that PlcPcd.aCp[i] ≤ cp. As with
@@ -37,10 +48,12 @@ void get_char_for_cp(cfb_doc_t *doc, CP cp,
  * than or equal to cp, cp is outside the range of valid
  * character positions in this document
  */
-	int i;
-	for (i=0; PlcPcd->aCp[i] <= cp;)
-		i++;
-	i--;	
+	int i = plc_search(PlcPcd->aCp, PlcPcd->aCPl, cp);
+	doc->stats.pieces++;
+	if (i < 0 || i + 1 >= PlcPcd->aCPl){
+		ERR("cp %u is outside of PlcPcd", cp);
+		return 0;
+	}
 
 /*
  * PlcPcd.aPcd[i] is a Pcd. Pcd.fc is an FcCompressed that
@@ -69,16 +82,18 @@ void get_char_for_cp(cfb_doc_t *doc, CP cp,
 		doc->prop.chp.cp = cp;
 
 		fseek(doc->WordDocument, off, SEEK_SET);	
-		int ch;
+		int ch = 0;
 		fread(&ch, 1, 1, 
 					doc->WordDocument);
+		doc->stats.seeks++;
+		doc_budget_read(doc, 1);
 		
 		// check special chars
 		int sch = FcCompressedSpecialChar_get(ch);
 		if (sch)
-			callback(user_data, part, &doc->prop, sch);
+			return _emit(doc, user_data, part, callback, sch);
 		else
-			callback(user_data, part, &doc->prop, ch);
+			return _emit(doc, user_data, part, callback, ch);
 		
 		//check_marks(doc, ch);
 
@@ -104,6 +119,8 @@ void get_char_for_cp(cfb_doc_t *doc, CP cp,
 		WORD u;
 		fread(&u, 2, 1, 
 					doc->WordDocument);
+		doc->stats.seeks++;
+		doc_budget_read(doc, 2);
 		if (doc->biteOrder){
 			u = bswap_16(u);
 		}
@@ -117,22 +134,25 @@ void get_char_for_cp(cfb_doc_t *doc, CP cp,
 			// first byte in uint16 is 00
 			if (u > 0x1f && u < 0x7f) {
 				//simple ANSI
-				int ch;
+				int ch = 0;
 				fread(&ch, 1, 1,
 						doc->WordDocument);
 		
-				callback(user_data, part, &doc->prop, ch);
+				return _emit(doc, user_data, part, callback, ch);
 			} else {
 				//this is a mark
-				callback(user_data, part, &doc->prop, u);
+				return _emit(doc, user_data, part, callback, u);
 				//check_marks(doc, u);
 			}
 		} else if (u != 0xfeff) {
 			char utf8[4]={0};
 			_utf16_to_utf8(&u, 1, utf8);
 			for (i = 0; i < 4; ++i) {
-				callback(user_data, part, &doc->prop, utf8[i]);
+				int ret = _emit(doc, user_data, part, callback, utf8[i]);
+				if (ret)
+					return ret;
 			}
 		}
 	}
+	return 0;
 }
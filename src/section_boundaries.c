@@ -2,7 +2,7 @@
  * File              : section_boundaries.c
  * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
  * Date              : 26.05.2024
- * Last Modified Date: 05.08.2024
+ * Last Modified Date: 18.10.2026
  * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
  */
 
@@ -11,19 +11,27 @@
 /* Determining Section Boundaries */
 CP last_cp_in_section(cfb_doc_t *doc, CP cp)
 {
+	struct PlcfSed *plcfSed = doc_plcfSed(doc);
+	if (!plcfSed)
+		return CPERROR;
+
 	int i;
-	for (i=0; doc->plcfSed->aCP[i] < cp;)
+	for (i=0; plcfSed->aCP[i] < cp;)
 		i++;
 
-	return doc->plcfSed->aCP[i] - 1;
+	return plcfSed->aCP[i] - 1;
 }
 
 CP first_cp_in_section(cfb_doc_t *doc, CP cp)
 {
+	struct PlcfSed *plcfSed = doc_plcfSed(doc);
+	if (!plcfSed)
+		return CPERROR;
+
 	int i;
-	for (i=0; doc->plcfSed->aCP[i] <= cp;)
+	for (i=0; plcfSed->aCP[i] <= cp;)
 		i++;
 	i--;	
 
-	return doc->plcfSed->aCP[i];
+	return plcfSed->aCP[i];
 }
@@ -2,7 +2,7 @@
  * File              : style_properties.c
  * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
  * Date              : 28.05.2024
- * Last Modified Date: 07.08.2024
+ * Last Modified Date: 18.10.2026
  * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
  */
 
@@ -12,6 +12,7 @@
 #include "memread.h"
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 static int callbackPar(void *userdata, struct Prl *prl);
 static int callbackChar(void *userdata, struct Prl *prl);
@@ -26,25 +27,24 @@ static int callbackChar(void *userdata, struct Prl *prl);
  * paragraphs, and characters. */
 
 /* Given an istd: */
- struct LPStd *apply_style_properties(cfb_doc_t *doc, USHORT istd)
+static struct LPStd *_apply_style_properties(
+		cfb_doc_t *doc, USHORT istd)
 {
 /* 1. Read the FIB from offset zero in the WordDocument
- * Stream. */
-	struct Fib *fib = &doc->fib;
+ * Stream - it is read by doc_open. */
 
 /* 2. All versions of the FIB contain exactly one
  * FibRgFcLcb97 though it can be nested in a larger
  * structure. Read a STSH from offset FibRgFcLcb97.fcStshf
  * in the Table Stream with size
  * FibRgFcLcb97.lcbStshf. */
-	struct STSH *STSH = &doc->STSH;
+	struct STSH *STSH = doc_stsh(doc);
+	if (!STSH)
+		return NULL;
 
 /* 3. The given istd is a zero-based index into
  * STSH.rglpstd. Read an LPStd at STSH.rglpstd[istd]. */
-	USHORT cstd = doc->STSH.lpstshi->stshi->stshif.cstd;
-	struct LPStd *LPStd = 
-		LPStd_at_index(STSH->rglpstd, 
-				cstd, istd);
+	struct LPStd *LPStd = doc_lpstd(doc, istd);
 	if (!LPStd){
 #ifdef DEBUG
 	LOG("no STD int STSH at index: %d", istd);
@@ -247,6 +247,43 @@ static int callbackChar(void *userdata, struct Prl *prl);
 #endif
 	return LPStd;
 }
+struct LPStd *apply_style_properties(cfb_doc_t *doc, USHORT istd)
+{
+	// text-only parsing does not read style sheet
+	if (doc->textOnly)
+		return NULL;
+
+	struct STSH *STSH = doc_stsh(doc);
+	if (!STSH)
+		return NULL;
+
+	// styles are nested by istdBase and by sprmCIstd or 
+	// sprmPIstd in style properties - each style is applied
+	// once by resolution, so cycles and shared bases do not
+	// repeat work
+	if (istd >= 0x0FFF)
+		return NULL;
+	if (doc->styleDepth == 0)
+		memset(doc->styleVisited, 0, sizeof(doc->styleVisited));
+	if (doc->styleVisited[istd >> 3] & (1 << (istd & 7))){
+#ifdef DEBUG
+	LOG("style %d is already applied", istd);
+#endif
+		return NULL;
+	}
+	doc->styleVisited[istd >> 3] |= 1 << (istd & 7);
+	if (doc_budget_step(doc))
+		return NULL;
+
+	doc->stats.styles++;
+	DOC_PROBE2(style__resolve, doc, istd);
+	doc->styleDepth++;
+	struct LPStd *LPStd = _apply_style_properties(doc, istd);
+	doc->styleDepth--;
+	
+	return LPStd;
+}
+
 int callbackPar(void *userdata, struct Prl *prl){
 	// parse properties
 	//USHORT ismpd = SprmIspmd(prl->sprm);
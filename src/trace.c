@@ -0,0 +1,91 @@
+/**
+ * File              : trace.c
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+#include "../include/libdoc/doc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int doc_trace_on;
+
+static struct {
+	struct doc_trace_event *ev;
+	unsigned long cap;    // number of slots
+	unsigned long head;   // number of recorded events
+	double start;         // doc_clock at doc_trace_start
+} _trace;
+
+/* thread numbers for tid of events */
+static unsigned int _tids;
+static __thread unsigned int _tid;
+
+int doc_trace_start(size_t capacity)
+{
+	__atomic_store_n(&doc_trace_on, 0, __ATOMIC_RELEASE);
+	free(_trace.ev);
+	memset(&_trace, 0, sizeof(_trace));
+	if (capacity == 0)
+		return 0;
+
+	_trace.ev = malloc(capacity * sizeof(struct doc_trace_event));
+	if (!_trace.ev){
+		ERR("malloc");
+		return DOC_ERR_ALLOC;
+	}
+	// touch pages now, not while recording
+	memset(_trace.ev, 0, capacity * sizeof(struct doc_trace_event));
+	
+	_trace.cap = capacity;
+	_trace.start = doc_clock();
+	__atomic_store_n(&doc_trace_on, 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+void doc_trace_stop()
+{
+	__atomic_store_n(&doc_trace_on, 0, __ATOMIC_RELEASE);
+}
+
+void doc_trace_event(char ph, const char *name, long arg)
+{
+	if (!_tid)
+		_tid = __atomic_add_fetch(&_tids, 1, __ATOMIC_RELAXED);
+	
+	unsigned long n = 
+		__atomic_fetch_add(&_trace.head, 1, __ATOMIC_RELAXED);
+	struct doc_trace_event *e = &_trace.ev[n % _trace.cap];
+	e->name = name;
+	e->ph = ph;
+	e->tid = _tid;
+	e->ts = doc_clock();
+	e->arg = arg;
+}
+
+int doc_trace_write(FILE *fp)
+{
+	if (!_trace.ev)
+		return DOC_ERR_FILE;
+	
+	unsigned long head = 
+		__atomic_load_n(&_trace.head, __ATOMIC_ACQUIRE);
+	unsigned long i = head > _trace.cap ? head - _trace.cap : 0;
+	int pid = getpid();
+	
+	fprintf(fp, "{\"traceEvents\":[\n");
+	for (; i < head; ++i) {
+		struct doc_trace_event *e = &_trace.ev[i % _trace.cap];
+		fprintf(fp, 
+				"{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+				"\"pid\":%d,\"tid\":%u,\"args\":{\"arg\":%ld}}%s\n",
+				e->name, e->ph, (e->ts - _trace.start) * 1e6,
+				pid, e->tid, e->arg, i + 1 < head ? "," : "");
+	}
+	fprintf(fp, "],\"displayTimeUnit\":\"ms\"}\n");
+	
+	return ferror(fp) ? DOC_ERR_FILE : 0;
+}
@@ -0,0 +1,165 @@
+/**
+ * File              : uid_cache.c
+ * Author            : Igor V. Sementsov <ig.kuzm@gmail.com>
+ * Date              : 18.10.2026
+ * Last Modified Date: 18.10.2026
+ * Last Modified By  : Igor V. Sementsov <ig.kuzm@gmail.com>
+ */
+
+#include "../include/libdoc/doc.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Picture UID cache.
+ * BLIP records carry MD4 digest of picture data (rgbUid1 of
+ * OfficeArtBlip*, rgbUid of OfficeArtFBSE). The cache is an
+ * open addressing hash set of full 16-byte UIDs - UIDs are
+ * bytes of file, not verified digests, so hash only selects
+ * slot and UIDs are compared whole. Slot is claimed with 
+ * compare-and-swap of its state, UID is written and slot is
+ * published, so many threads can test and insert without 
+ * locks. UIDs are never removed */
+enum {
+	UID_EMPTY,
+	UID_WRITING,  // claimed, UID is being written
+	UID_READY,
+};
+
+struct uid_slot {
+	_Atomic int state;
+	unsigned char uid[16];
+};
+
+struct doc_uid_cache {
+	size_t mask;              // number of slots - 1
+	struct uid_slot slot[];
+};
+
+doc_uid_cache_t *doc_uid_cache_new(size_t capacity)
+{
+	// keep load factor below 1/2
+	size_t n = 16;
+	while (n < capacity * 2)
+		n <<= 1;
+
+	doc_uid_cache_t *cache = malloc(sizeof(doc_uid_cache_t) +
+			n * sizeof(struct uid_slot));
+	if (!cache){
+		ERR("malloc");
+		return NULL;
+	}
+
+	cache->mask = n - 1;
+	for (size_t i = 0; i < n; ++i)
+		atomic_init(&cache->slot[i].state, UID_EMPTY);
+
+	return cache;
+}
+
+void doc_uid_cache_free(doc_uid_cache_t *cache)
+{
+	free(cache);
+}
+
+/* state of published slot - wait while other thread 
+ * writes UID */
+static int _uid_slot_state(struct uid_slot *slot)
+{
+	int state;
+	while ((state = atomic_load_explicit(
+					&slot->state, memory_order_acquire)) == UID_WRITING)
+		;
+	return state;
+}
+
+/* find uid in cache - with insert add it to empty slot. 
+ * Return 1 if uid was in cache */
+static int _uid_cache_find(
+		doc_uid_cache_t *cache, const unsigned char uid[16],
+		int insert)
+{
+	static const unsigned char nouid[16];
+	if (!memcmp(uid, nouid, 16))
+		return 0;
+
+	uint64_t a, b;
+	memcpy(&a, uid, 8);
+	memcpy(&b, uid + 8, 8);
+	// mix halves, so [A|B] and [B|A] start in other slots
+	uint64_t h = (a * 0x9E3779B97F4A7C15ULL) ^ b;
+	h ^= h >> 29;
+
+	size_t i, n;
+	for (i = h & cache->mask, n = 0;
+			n <= cache->mask;
+			i = (i + 1) & cache->mask, n++)
+	{
+		struct uid_slot *slot = &cache->slot[i];
+		int state = _uid_slot_state(slot);
+		
+		if (state == UID_EMPTY){
+			if (!insert)
+				return 0;
+			int expected = UID_EMPTY;
+			if (atomic_compare_exchange_strong_explicit(
+						&slot->state, &expected, UID_WRITING,
+						memory_order_acq_rel, memory_order_acquire))
+			{
+				memcpy(slot->uid, uid, 16);
+				atomic_store_explicit(
+						&slot->state, UID_READY, memory_order_release);
+				return 0;
+			}
+			// other thread took slot
+			_uid_slot_state(slot);
+		}
+
+		if (!memcmp(slot->uid, uid, 16))
+			return 1;
+	}
+
+	// cache is full - picture is not remembered
+	return 0;
+}
+
+int doc_uid_cache_seen(void *userdata, const unsigned char uid[16])
+{
+	return _uid_cache_find(userdata, uid, 0);
+}
+
+void doc_uid_cache_mark(void *userdata, const unsigned char uid[16])
+{
+	_uid_cache_find(userdata, uid, 1);
+}
+
+/* process-wide predicate for picture extraction */
+static struct {
+	int (*seen)(void *userdata, const unsigned char uid[16]);
+	void (*mark)(void *userdata, const unsigned char uid[16]);
+	void *userdata;
+} _uid_seen;
+
+void doc_set_uid_seen(
+		int (*seen)(void *userdata, const unsigned char uid[16]),
+		void (*mark)(void *userdata, const unsigned char uid[16]),
+		void *userdata)
+{
+	_uid_seen.userdata = userdata;
+	_uid_seen.seen = seen;
+	_uid_seen.mark = mark;
+}
+
+int doc_uid_seen(const unsigned char uid[16])
+{
+	if (!_uid_seen.seen)
+		return 0;
+	return _uid_seen.seen(_uid_seen.userdata, uid);
+}
+
+void doc_uid_mark(const unsigned char uid[16])
+{
+	if (_uid_seen.mark)
+		_uid_seen.mark(_uid_seen.userdata, uid);
+}